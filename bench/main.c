@@ -0,0 +1,524 @@
+#include "http_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#define HAVE_CLFLUSH
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define HAVE_RDTSC
+#define HAVE_CLFLUSH
+#endif
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof(a[0]))
+
+#ifndef BENCH_CORPUS_DIR
+#define BENCH_CORPUS_DIR "corpus"
+#endif
+
+#define MAX_MESSAGES 1024
+#define MAX_HEADERS  128
+#define MAX_LANES    64
+
+//
+// Usage: bench [--corpus DIR] [--json FILE] [--impl NAME] [--repetitions N] [--min-time MS] [--check-tiers]
+//
+// Every corpus file is parsed over and over until --min-time has passed, that is one repetition.
+// The fastest repetition is reported (it's the one least disturbed by everything else on the machine),
+// the median too.
+//
+// Cold corpora have every message in a buffer of its own, flushed from the caches before every pass
+// (outside of the measured time), like requests that just arrived on different connections.
+//
+// With --check-tiers the exit code is 1 if a tier above SSE2 is much slower than SSE2 on any corpus,
+// which is usually a bug in the wider kernels (e.g. SSE/AVX transition stalls). It's timing, so a loaded
+// machine or a CPU that runs wide vectors slowly fails it too: it's run by hand, or with the bench_check_tiers
+// target (HTTP_PARSER_BENCH_CHECK_TIERS), never as a test. Only optimized builds are checked.
+//
+
+#define TIER_MIN_RATIO 0.5
+
+typedef struct {
+    const char* data;
+    size_t count;
+} string;
+
+typedef enum {
+    CORPUS_REQUESTS,  // req_*.http - pipelined requests, parsed one by one with http_parse_request
+    CORPUS_RESPONSES, // resp_*.http - responses, parsed one by one with http_parse_response
+    CORPUS_CHUNKED,   // chunked_*.http - one chunked body, decoded with http_decode_chunked
+    CORPUS_LAZY,      // req_*.http again, with http_parse_request_lazy and no headers asked for
+    CORPUS_MULTI,     // req_*.http again, in groups of `lanes` requests with http_parse_requests_multi
+} corpus_kind_t;
+
+typedef struct {
+    const char* file_name;
+    corpus_kind_t kind;
+    size_t lanes;
+    bool cold;
+
+    char* data;
+    size_t size;
+
+    string messages[MAX_MESSAGES];
+    size_t num_messages;
+} corpus_t;
+
+static const struct {
+    const char* file_name;
+    corpus_kind_t kind;
+    size_t lanes;
+    bool cold;
+} corpus_files[] = {
+    {"req_browser_get.http", CORPUS_REQUESTS,  0,  false},
+    {"req_api_post.http",    CORPUS_REQUESTS,  0,  false},
+    {"resp_cdn.http",        CORPUS_RESPONSES, 0,  false},
+    {"chunked_body.http",    CORPUS_CHUNKED,   0,  false},
+    {"req_browser_get.http", CORPUS_LAZY,      0,  false},
+    {"req_browser_get.http", CORPUS_MULTI,     8,  false},
+    {"req_browser_get.http", CORPUS_MULTI,     16, false},
+    {"req_browser_get.http", CORPUS_MULTI,     64, false},
+    {"req_browser_get.http", CORPUS_REQUESTS,  0,  true},
+    {"req_browser_get.http", CORPUS_MULTI,     8,  true},
+    {"req_browser_get.http", CORPUS_MULTI,     16, true},
+    {"req_browser_get.http", CORPUS_MULTI,     64, true},
+};
+
+static const char* translate_corpus_kind(corpus_kind_t kind) {
+    switch (kind) {
+        case CORPUS_REQUESTS:  return "http_parse_request";
+        case CORPUS_RESPONSES: return "http_parse_response";
+        case CORPUS_CHUNKED:   return "http_decode_chunked";
+        case CORPUS_LAZY:      return "http_parse_request_lazy";
+        case CORPUS_MULTI:     return "http_parse_requests_multi";
+    }
+    return "unknown";
+}
+
+static const char* describe_function(const corpus_t* corpus, char* buf, size_t buf_len) {
+    if (corpus->kind != CORPUS_MULTI && !corpus->cold) {
+        return translate_corpus_kind(corpus->kind);
+    }
+
+    int len = snprintf(buf, buf_len, "%s", translate_corpus_kind(corpus->kind));
+    if (corpus->kind == CORPUS_MULTI) {
+        len += snprintf(buf + len, buf_len - (size_t) len, "/%zu", corpus->lanes);
+    }
+    if (corpus->cold) {
+        snprintf(buf + len, buf_len - (size_t) len, " cold");
+    }
+    return buf;
+}
+
+typedef struct {
+    double seconds;
+    uint64_t cycles;
+    size_t bytes;
+    size_t messages;
+} measurement_t;
+
+static double now_seconds() {
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static uint64_t read_cycles() {
+#if defined(HAVE_RDTSC)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static bool load_corpus(const char* dir, corpus_t* corpus) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, corpus->file_name);
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Couldn't open %s\n", path);
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    corpus->data = malloc((size_t) size);
+    corpus->size = fread(corpus->data, 1, (size_t) size, f);
+    fclose(f);
+
+    corpus->num_messages = 0;
+
+    if (corpus->kind == CORPUS_CHUNKED) {
+        corpus->messages[0] = (string) {corpus->data, corpus->size};
+        corpus->num_messages = 1;
+        return true;
+    }
+
+    // Split into messages once, so that only parsing is measured
+    size_t offset = 0;
+    while (offset < corpus->size && corpus->num_messages < MAX_MESSAGES) {
+        http_header_t headers_buf[MAX_HEADERS];
+        size_t consumed;
+        http_parsing_result_t result;
+        if (corpus->kind == CORPUS_REQUESTS || corpus->kind == CORPUS_LAZY || corpus->kind == CORPUS_MULTI) {
+            http_request_t request;
+            result = http_parse_request_framed(corpus->data + offset, corpus->size - offset,
+                                               headers_buf, MAX_HEADERS, &request, &consumed);
+        } else {
+            http_response_t response;
+            result = http_parse_response_framed(corpus->data + offset, corpus->size - offset,
+                                                headers_buf, MAX_HEADERS, &response, &consumed);
+        }
+        if (result != PARSING_RES_SUCCEEDED) {
+            fprintf(stderr, "%s: message %zu: %s\n", corpus->file_name, corpus->num_messages,
+                    translate_http_parsing_result(result));
+            return false;
+        }
+
+        corpus->messages[corpus->num_messages++] = (string) {corpus->data + offset, consumed};
+        offset += consumed;
+    }
+
+    if (corpus->kind == CORPUS_MULTI) {
+        // Repeat the messages until every group is full, then bytes are counted per message
+        size_t file_messages = corpus->num_messages;
+        while (corpus->num_messages % corpus->lanes != 0 && corpus->num_messages + file_messages <= MAX_MESSAGES) {
+            memcpy(corpus->messages + corpus->num_messages, corpus->messages, file_messages * sizeof(string));
+            corpus->num_messages += file_messages;
+        }
+
+        corpus->size = 0;
+        for (size_t i = 0; i < corpus->num_messages; i++) {
+            corpus->size += corpus->messages[i].count;
+        }
+    }
+
+    if (corpus->cold) {
+        // Distinct buffers, even for repeated messages
+        for (size_t i = 0; i < corpus->num_messages; i++) {
+            char* copy = malloc(corpus->messages[i].count);
+            memcpy(copy, corpus->messages[i].data, corpus->messages[i].count);
+            corpus->messages[i].data = copy;
+        }
+    }
+    return true;
+}
+
+static void evict_messages(const corpus_t* corpus) {
+#if defined(HAVE_CLFLUSH)
+    for (size_t i = 0; i < corpus->num_messages; i++) {
+        for (size_t offset = 0; offset < corpus->messages[i].count; offset += 64) {
+            _mm_clflush(corpus->messages[i].data + offset);
+        }
+        _mm_clflush(corpus->messages[i].data + corpus->messages[i].count - 1);
+    }
+    _mm_mfence();
+#else
+    (void) corpus;
+#endif
+}
+
+// Parses the messages of the corpus in groups of corpus->lanes.
+static size_t run_multi_once(const corpus_t* corpus) {
+    static http_header_t headers_pool[MAX_LANES * MAX_HEADERS];
+    const char* texts[MAX_LANES];
+    size_t text_lens[MAX_LANES];
+    http_request_t requests[MAX_LANES];
+    http_parsing_result_t results[MAX_LANES];
+    size_t check = 0;
+
+    for (size_t i = 0; i < corpus->num_messages; i += corpus->lanes) {
+        size_t n = corpus->num_messages - i < corpus->lanes ? corpus->num_messages - i : corpus->lanes;
+        for (size_t j = 0; j < n; j++) {
+            texts[j]     = corpus->messages[i + j].data;
+            text_lens[j] = corpus->messages[i + j].count;
+        }
+
+        if (http_parse_requests_multi(texts, text_lens, n, headers_pool, MAX_HEADERS, requests, results) != n) {
+            fprintf(stderr, "%s: a message in group at %zu failed\n", corpus->file_name, i);
+            exit(1);
+        }
+        for (size_t j = 0; j < n; j++) {
+            check += requests[j].headers_len;
+        }
+    }
+    return check;
+}
+
+// Parses every message of the corpus once. Returns a value that depends on the results so it's not optimized away.
+static size_t run_corpus_once(const corpus_t* corpus, char* decode_buf, size_t decode_buf_len) {
+    if (corpus->kind == CORPUS_MULTI) {
+        return run_multi_once(corpus);
+    }
+
+    size_t check = 0;
+    http_header_t headers_buf[MAX_HEADERS];
+
+    for (size_t i = 0; i < corpus->num_messages; i++) {
+        string message = corpus->messages[i];
+        http_parsing_result_t result;
+
+        switch (corpus->kind) {
+            case CORPUS_REQUESTS: {
+                http_request_t request;
+                result = http_parse_request(message.data, message.count, headers_buf, MAX_HEADERS, &request);
+                check += request.headers_len;
+                break;
+            }
+            case CORPUS_RESPONSES: {
+                http_response_t response;
+                result = http_parse_response(message.data, message.count, headers_buf, MAX_HEADERS, &response);
+                check += response.headers_len;
+                break;
+            }
+            case CORPUS_LAZY: {
+                http_lazy_request_t request;
+                result = http_parse_request_lazy(message.data, message.count, &request);
+                check += request.header_block_len;
+                break;
+            }
+            case CORPUS_CHUNKED: {
+                size_t decoded_len = 0;
+                result = http_decode_chunked(message.data, message.count, decode_buf, decode_buf_len, &decoded_len);
+                check += decoded_len;
+                break;
+            }
+            default: {
+                result = PARSING_RES_FAILED;
+                break;
+            }
+        }
+
+        if (result != PARSING_RES_SUCCEEDED) {
+            fprintf(stderr, "%s: message %zu: %s\n", corpus->file_name, i, translate_http_parsing_result(result));
+            exit(1);
+        }
+    }
+    return check;
+}
+
+static measurement_t measure(const corpus_t* corpus, double min_time) {
+    static char decode_buf[1 << 20];
+    static volatile size_t sink;
+
+    measurement_t m = {0};
+    do {
+        if (corpus->cold) {
+            evict_messages(corpus);
+        }
+
+        double start = now_seconds();
+        uint64_t start_cycles = read_cycles();
+        sink += run_corpus_once(corpus, decode_buf, sizeof(decode_buf));
+        m.cycles  += read_cycles() - start_cycles;
+        m.seconds += now_seconds() - start;
+
+        m.bytes    += corpus->size;
+        m.messages += corpus->num_messages;
+    } while (m.seconds < min_time);
+
+    return m;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double bytes_per_second;
+    double bytes_per_second_median;
+    double messages_per_second;
+    double ns_per_message;
+    double cycles_per_byte;
+} result_t;
+
+static result_t bench_corpus(const corpus_t* corpus, int repetitions, double min_time) {
+    // Warmup: caches, branch predictors, CPU frequency
+    measure(corpus, min_time);
+
+    double throughputs[64];
+    if (repetitions > (int) ARRAY_LENGTH(throughputs)) {
+        repetitions = (int) ARRAY_LENGTH(throughputs);
+    }
+
+    measurement_t best = {0};
+    for (int i = 0; i < repetitions; i++) {
+        measurement_t m = measure(corpus, min_time);
+        throughputs[i] = (double) m.bytes / m.seconds;
+        if (i == 0 || throughputs[i] > (double) best.bytes / best.seconds) {
+            best = m;
+        }
+    }
+    qsort(throughputs, (size_t) repetitions, sizeof(throughputs[0]), compare_doubles);
+
+    result_t r;
+    r.bytes_per_second        = (double) best.bytes / best.seconds;
+    r.bytes_per_second_median = throughputs[repetitions / 2];
+    r.messages_per_second     = (double) best.messages / best.seconds;
+    r.ns_per_message          = best.seconds * 1e9 / (double) best.messages;
+    r.cycles_per_byte         = (double) best.cycles / (double) best.bytes;
+    return r;
+}
+
+static bool parse_impl(const char* name, http_parser_impl_t* out_impl) {
+    for (int impl = HTTP_PARSER_IMPL_AUTO; impl <= HTTP_PARSER_IMPL_AVX512; impl++) {
+        if (strcmp(name, translate_http_parser_impl((http_parser_impl_t) impl)) == 0) {
+            *out_impl = (http_parser_impl_t) impl;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    const char* corpus_dir = BENCH_CORPUS_DIR;
+    const char* json_path = NULL;
+    const char* only_impl = NULL;
+    int repetitions = 10;
+    double min_time = 0.05;
+    bool check_tiers = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpus_dir = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--impl") == 0 && i + 1 < argc) {
+            only_impl = argv[++i];
+        } else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]) / 1000.0;
+        } else if (strcmp(argv[i], "--check-tiers") == 0) {
+            check_tiers = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--corpus DIR] [--json FILE] [--impl NAME] [--repetitions N] [--min-time MS] [--check-tiers]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (repetitions < 1) {
+        repetitions = 1;
+    }
+
+#if !defined(__OPTIMIZE__) && !defined(NDEBUG)
+    fprintf(stderr, "Warning: not an optimized build, configure with -DCMAKE_BUILD_TYPE=Release\n");
+    if (check_tiers) {
+        // Unoptimized vector code is slow in ways that say nothing about the optimized one
+        fprintf(stderr, "Tiers aren't checked\n");
+        return 0;
+    }
+#endif
+
+    static corpus_t corpora[ARRAY_LENGTH(corpus_files)];
+    for (size_t i = 0; i < ARRAY_LENGTH(corpus_files); i++) {
+        corpora[i].file_name = corpus_files[i].file_name;
+        corpora[i].kind      = corpus_files[i].kind;
+        corpora[i].lanes     = corpus_files[i].lanes;
+        corpora[i].cold      = corpus_files[i].cold;
+        if (!load_corpus(corpus_dir, &corpora[i])) {
+            return 1;
+        }
+    }
+
+    FILE* json = NULL;
+    if (json_path) {
+        json = fopen(json_path, "w");
+        if (!json) {
+            fprintf(stderr, "Couldn't open %s\n", json_path);
+            return 1;
+        }
+        fprintf(json, "{\n  \"repetitions\": %d,\n  \"min_time_ms\": %g,\n  \"results\": [", repetitions, min_time * 1000.0);
+    }
+
+    printf("%-8s %-22s %-34s %8s %10s %12s %10s %8s\n",
+           "impl", "corpus", "function", "GB/s", "med GB/s", "msgs/s", "ns/msg", "cyc/B");
+
+    // Best throughput of every tier on every corpus, 0 if the tier didn't run
+    static double throughputs[HTTP_PARSER_IMPL_AVX512 + 1][ARRAY_LENGTH(corpus_files)];
+
+    bool first_result = true;
+    for (int impl = HTTP_PARSER_IMPL_SCALAR; impl <= HTTP_PARSER_IMPL_AVX512; impl++) {
+        if (only_impl) {
+            http_parser_impl_t wanted;
+            if (!parse_impl(only_impl, &wanted)) {
+                fprintf(stderr, "Unknown impl %s\n", only_impl);
+                return 1;
+            }
+            if (wanted == HTTP_PARSER_IMPL_AUTO) {
+                http_parser_set_impl(HTTP_PARSER_IMPL_AUTO);
+                wanted = http_parser_get_impl();
+            }
+            if (impl != (int) wanted) {
+                continue;
+            }
+        }
+        if (!http_parser_set_impl((http_parser_impl_t) impl)) {
+            continue;
+        }
+        const char* impl_name = translate_http_parser_impl((http_parser_impl_t) impl);
+
+        for (size_t i = 0; i < ARRAY_LENGTH(corpora); i++) {
+            const corpus_t* corpus = &corpora[i];
+            result_t r = bench_corpus(corpus, repetitions, min_time);
+            throughputs[impl][i] = r.bytes_per_second;
+            char function_buf[64];
+            const char* function = describe_function(corpus, function_buf, sizeof(function_buf));
+
+            printf("%-8s %-22s %-34s %8.3f %10.3f %12.0f %10.1f %8.3f\n",
+                   impl_name, corpus->file_name, function,
+                   r.bytes_per_second / 1e9, r.bytes_per_second_median / 1e9,
+                   r.messages_per_second, r.ns_per_message, r.cycles_per_byte);
+
+            if (json) {
+                fprintf(json, "%s\n    {\"impl\": \"%s\", \"corpus\": \"%s\", \"function\": \"%s\", "
+                              "\"bytes\": %zu, \"messages\": %zu, "
+                              "\"bytes_per_second\": %.0f, \"bytes_per_second_median\": %.0f, "
+                              "\"messages_per_second\": %.0f, \"ns_per_message\": %.2f, \"cycles_per_byte\": %.4f}",
+                        first_result ? "" : ",", impl_name, corpus->file_name, function,
+                        corpus->size, corpus->num_messages,
+                        r.bytes_per_second, r.bytes_per_second_median,
+                        r.messages_per_second, r.ns_per_message, r.cycles_per_byte);
+                first_result = false;
+            }
+        }
+    }
+
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+
+    http_parser_set_impl(HTTP_PARSER_IMPL_AUTO);
+
+    int status = 0;
+    if (check_tiers) {
+        for (int impl = HTTP_PARSER_IMPL_SSE2 + 1; impl <= HTTP_PARSER_IMPL_AVX512; impl++) {
+            for (size_t i = 0; i < ARRAY_LENGTH(corpora); i++) {
+                double baseline = throughputs[HTTP_PARSER_IMPL_SSE2][i];
+                if (throughputs[impl][i] > 0 && baseline > 0 && throughputs[impl][i] < baseline * TIER_MIN_RATIO) {
+                    char function_buf[64];
+                    fprintf(stderr, "%s is slower than sse2 on %s with %s: %.3f vs %.3f GB/s\n",
+                            translate_http_parser_impl((http_parser_impl_t) impl), corpora[i].file_name,
+                            describe_function(&corpora[i], function_buf, sizeof(function_buf)),
+                            throughputs[impl][i] / 1e9, baseline / 1e9);
+                    status = 1;
+                }
+            }
+        }
+    }
+    return status;
+}
@@ -0,0 +1,626 @@
+#define _GNU_SOURCE
+
+#include "http_uring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof(a[0]))
+
+#define BUFFER_GROUP 0
+#define MAX_HEADERS  64
+
+static const char response_bad_request[] =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static const char response_too_large[] =
+    "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+struct http_uring_conn {
+    int fd;
+
+    bool recv_armed;        /* multishot recv is in flight */
+    bool send_in_flight;
+    bool blocked;           /* output was full, the rest of the input waits in `in` */
+    bool close_after_write;
+    bool input_ended;       /* the client shut down its side, closed once everything it sent is answered */
+    bool closing;
+
+    /* Start of a request that continues in the next buffer (or input that waits for output space) */
+    size_t in_len;
+    char in[HTTP_URING_CONN_BUF_SIZE];
+
+    /* Responses, out_sent..out_len is being sent. Appending is fine while a send is in flight */
+    size_t out_len;
+    size_t out_sent;
+    size_t response_len;    /* queued by the handler for the request it handles */
+    char out[HTTP_URING_CONN_BUF_SIZE];
+
+    http_uring_conn_t *prev;
+    http_uring_conn_t *next;
+};
+
+// Kind of operation is kept in the low bits of user_data, the connection in the rest
+typedef enum {
+    OP_ACCEPT,
+    OP_RECV,
+    OP_SEND,
+} op_t;
+
+static uint64_t op_user_data(http_uring_conn_t* conn, op_t op) {
+    return (uint64_t) (uintptr_t) conn | (uint64_t) op;
+}
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t arg_size) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Submission queue
+
+static int submit(http_uring_t* u, unsigned min_complete, long timeout_ns) {
+    unsigned to_submit = u->sq_local_tail - u->sq_submitted;
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    struct __kernel_timespec ts = {0, timeout_ns};
+    struct io_uring_getevents_arg arg = {0};
+    arg.ts = (uint64_t) (uintptr_t) &ts;
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    }
+
+    int ret = sys_io_uring_enter(u->ring_fd, to_submit, min_complete, flags,
+                                 min_complete > 0 ? &arg : NULL, min_complete > 0 ? sizeof(arg) : 0);
+    if (ret < 0) {
+        return -errno;
+    }
+    u->sq_submitted += (unsigned) ret;
+    return ret;
+}
+
+static struct io_uring_sqe* get_sqe(http_uring_t* u) {
+    if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+        // Full, hand what's there to the kernel first
+        submit(u, 0, 0);
+        if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+            return NULL;
+        }
+    }
+
+    unsigned index = u->sq_local_tail & u->sq_mask;
+    struct io_uring_sqe* sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[index] = index;
+    u->sq_local_tail++;
+    return sqe;
+}
+
+// Provided buffers
+
+static char* buffer_data(http_uring_t* u, unsigned bid) {
+    return u->buf_data + (size_t) bid * u->buf_size;
+}
+
+static void return_buffer(http_uring_t* u, unsigned bid) {
+    struct io_uring_buf* buf = &u->buf_ring->bufs[u->buf_tail & (u->buf_count - 1)];
+    buf->addr = (uint64_t) (uintptr_t) buffer_data(u, bid);
+    buf->len  = u->buf_size;
+    buf->bid  = (uint16_t) bid;
+
+    u->buf_tail++;
+    __atomic_store_n(&u->buf_ring->tail, u->buf_tail, __ATOMIC_RELEASE);
+}
+
+// Operations
+
+static void arm_accept(http_uring_t* u) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = u->listen_fd;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data    = op_user_data(NULL, OP_ACCEPT);
+}
+
+static void arm_recv(http_uring_t* u, http_uring_conn_t* conn) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = conn->fd;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = op_user_data(conn, OP_RECV);
+    conn->recv_armed = true;
+}
+
+static void flush_output(http_uring_t* u, http_uring_conn_t* conn) {
+    if (conn->send_in_flight || conn->out_sent == conn->out_len) {
+        return;
+    }
+
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = conn->fd;
+    sqe->addr      = (uint64_t) (uintptr_t) (conn->out + conn->out_sent);
+    sqe->len       = (uint32_t) (conn->out_len - conn->out_sent);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = op_user_data(conn, OP_SEND);
+    conn->send_in_flight = true;
+}
+
+// Connections
+
+static void finish_close(http_uring_t* u, http_uring_conn_t* conn) {
+    if (conn->recv_armed || conn->send_in_flight) {
+        // Freed when the last operation completes
+        return;
+    }
+
+    close(conn->fd);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        u->conns = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    free(conn);
+}
+
+// Pending operations are woken up by the shutdown, the connection is freed once they complete
+static void start_close(http_uring_t* u, http_uring_conn_t* conn) {
+    if (!conn->closing) {
+        conn->closing = true;
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+    finish_close(u, conn);
+}
+
+static void open_connection(http_uring_t* u, int fd) {
+    http_uring_conn_t* conn = malloc(sizeof(http_uring_conn_t));
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    // Buffers don't need to be cleared
+    memset(conn, 0, offsetof(http_uring_conn_t, in));
+    conn->fd       = fd;
+    conn->out_len      = 0;
+    conn->out_sent     = 0;
+    conn->response_len = 0;
+
+    conn->prev = NULL;
+    conn->next = u->conns;
+    if (u->conns) {
+        u->conns->prev = conn;
+    }
+    u->conns = conn;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    arm_recv(u, conn);
+}
+
+// Returns false if it doesn't fit
+static bool queue_output(http_uring_conn_t* conn, const char* data, size_t len) {
+    if (len > sizeof(conn->out) - conn->out_len) {
+        return false;
+    }
+    memcpy(conn->out + conn->out_len, data, len);
+    conn->out_len += len;
+    return true;
+}
+
+bool http_uring_respond(http_uring_conn_t *conn, const char *data, size_t len) {
+    if (len > HTTP_URING_MAX_RESPONSE - conn->response_len || !queue_output(conn, data, len)) {
+        return false;
+    }
+    conn->response_len += len;
+    return true;
+}
+
+//
+// Handles complete requests in data. Returns how much of it was consumed,
+// the rest is either an incomplete request or has to wait until there's room for responses.
+//
+static size_t handle_requests(http_uring_t* u, http_uring_conn_t* conn, const char* data, size_t len) {
+    size_t offset = 0;
+    conn->blocked = false;
+
+    while (offset < len && !conn->close_after_write) {
+        if (sizeof(conn->out) - conn->out_len < HTTP_URING_MAX_RESPONSE) {
+            conn->blocked = true;
+            break;
+        }
+
+        http_header_t headers_buf[MAX_HEADERS];
+        http_request_t request;
+        size_t consumed;
+        http_parsing_result_t result = http_parse_request_framed(data + offset, len - offset,
+                                                                 headers_buf, ARRAY_LENGTH(headers_buf),
+                                                                 &request, &consumed);
+        if (result == PARSING_RES_NOT_ENOUGH_DATA) {
+            break;
+        }
+
+        if (result != PARSING_RES_SUCCEEDED) {
+            queue_output(conn, response_bad_request, sizeof(response_bad_request) - 1);
+            conn->close_after_write = true;
+            return len;
+        }
+
+        u->requests++;
+        conn->response_len = 0;
+        if (!u->handler(u->user_data, conn, &request)) {
+            conn->close_after_write = true;
+        }
+        offset += consumed;
+    }
+
+    if (conn->close_after_write) {
+        // Nothing after this request is answered
+        return len;
+    }
+    return offset;
+}
+
+// Appends to the connection's own buffer, returns false if it doesn't fit
+static bool stash_input(http_uring_conn_t* conn, const char* data, size_t len) {
+    if (len > sizeof(conn->in) - conn->in_len) {
+        return false;
+    }
+    memcpy(conn->in + conn->in_len, data, len);
+    conn->in_len += len;
+    return true;
+}
+
+static void handle_stashed_input(http_uring_t* u, http_uring_conn_t* conn) {
+    size_t consumed = handle_requests(u, conn, conn->in, conn->in_len);
+    memmove(conn->in, conn->in + consumed, conn->in_len - consumed);
+    conn->in_len -= consumed;
+
+    if (conn->in_len == sizeof(conn->in) && !conn->blocked) {
+        // A single request doesn't fit
+        conn->in_len = 0;
+        queue_output(conn, response_too_large, sizeof(response_too_large) - 1);
+        conn->close_after_write = true;
+    }
+}
+
+static void handle_received(http_uring_t* u, http_uring_conn_t* conn, const char* data, size_t len) {
+    if (conn->close_after_write || conn->closing) {
+        return;
+    }
+
+    if (conn->in_len == 0) {
+        // Usual case: parse right in the kernel's buffer, keep only an incomplete request at its end
+        size_t consumed = handle_requests(u, conn, data, len);
+        if (consumed < len && !stash_input(conn, data + consumed, len - consumed)) {
+            queue_output(conn, response_too_large, sizeof(response_too_large) - 1);
+            conn->close_after_write = true;
+        }
+        return;
+    }
+
+    // Request continues from the previous buffer
+    if (!stash_input(conn, data, len)) {
+        conn->in_len = 0;
+        queue_output(conn, response_too_large, sizeof(response_too_large) - 1);
+        conn->close_after_write = true;
+        return;
+    }
+    if (!conn->blocked) {
+        uint64_t before = u->requests;
+        handle_stashed_input(u, conn);
+        if (u->requests > before) {
+            u->reassembled++;
+        }
+    }
+}
+
+// Completions
+
+static void complete_accept(http_uring_t* u, struct io_uring_cqe* cqe) {
+    if (cqe->res >= 0) {
+        open_connection(u, cqe->res);
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        arm_accept(u);
+    }
+}
+
+static void complete_recv(http_uring_t* u, http_uring_conn_t* conn, struct io_uring_cqe* cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        conn->recv_armed = false;
+    }
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe->res > 0) {
+            handle_received(u, conn, buffer_data(u, bid), (size_t) cqe->res);
+        }
+        return_buffer(u, bid);
+    }
+
+    if (conn->closing) {
+        finish_close(u, conn);
+        return;
+    }
+    if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+        start_close(u, conn);
+        return;
+    }
+    if (cqe->res == 0) {
+        // Closed by the client for sending, what it sent before is still answered
+        conn->input_ended = true;
+        if (conn->out_sent == conn->out_len && !conn->blocked) {
+            start_close(u, conn);
+            return;
+        }
+        flush_output(u, conn);
+        return;
+    }
+
+    flush_output(u, conn);
+    if (!conn->recv_armed) {
+        arm_recv(u, conn);
+    }
+}
+
+static void complete_send(http_uring_t* u, http_uring_conn_t* conn, struct io_uring_cqe* cqe) {
+    conn->send_in_flight = false;
+
+    if (conn->closing) {
+        finish_close(u, conn);
+        return;
+    }
+    if (cqe->res < 0) {
+        start_close(u, conn);
+        return;
+    }
+
+    conn->out_sent += (size_t) cqe->res;
+    if (conn->out_sent == conn->out_len) {
+        conn->out_len = conn->out_sent = 0;
+
+        if (conn->close_after_write) {
+            start_close(u, conn);
+            return;
+        }
+    }
+
+    if (conn->blocked) {
+        handle_stashed_input(u, conn);
+    }
+    if (conn->input_ended && conn->out_sent == conn->out_len && !conn->blocked) {
+        start_close(u, conn);
+        return;
+    }
+    flush_output(u, conn);
+}
+
+static void handle_completions(http_uring_t* u) {
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &u->cqes[head & u->cq_mask];
+        http_uring_conn_t* conn = (http_uring_conn_t*) (uintptr_t) (cqe->user_data & ~(uint64_t) 3);
+
+        switch ((op_t) (cqe->user_data & 3)) {
+            case OP_ACCEPT: complete_accept(u, cqe); break;
+            case OP_RECV:   complete_recv(u, conn, cqe); break;
+            case OP_SEND:   complete_send(u, conn, cqe); break;
+        }
+        head++;
+    }
+
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Setup
+
+static int map_rings(http_uring_t* u, const struct io_uring_params* p) {
+    u->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size) {
+            u->sq_ring_size = u->cq_ring_size;
+        }
+        u->cq_ring_size = u->sq_ring_size;
+    }
+
+    u->sq_ring_ptr = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          u->ring_fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring_ptr == MAP_FAILED) {
+        return -errno;
+    }
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ring_ptr = u->sq_ring_ptr;
+    } else {
+        u->cq_ring_ptr = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              u->ring_fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring_ptr == MAP_FAILED) {
+            return -errno;
+        }
+    }
+
+    u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   u->ring_fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        return -errno;
+    }
+
+    char* sq = u->sq_ring_ptr;
+    u->sq_head    = (unsigned*) (sq + p->sq_off.head);
+    u->sq_tail    = (unsigned*) (sq + p->sq_off.tail);
+    u->sq_array   = (unsigned*) (sq + p->sq_off.array);
+    u->sq_mask    = *(unsigned*) (sq + p->sq_off.ring_mask);
+    u->sq_entries = p->sq_entries;
+    u->sq_local_tail = u->sq_submitted = *u->sq_tail;
+
+    char* cq = u->cq_ring_ptr;
+    u->cq_head = (unsigned*) (cq + p->cq_off.head);
+    u->cq_tail = (unsigned*) (cq + p->cq_off.tail);
+    u->cq_mask = *(unsigned*) (cq + p->cq_off.ring_mask);
+    u->cqes    = (struct io_uring_cqe*) (cq + p->cq_off.cqes);
+    return 0;
+}
+
+static int register_buffers(http_uring_t* u, unsigned buffer_count, unsigned buffer_size) {
+    u->buf_count = buffer_count;
+    u->buf_size  = buffer_size;
+
+    u->buf_ring_size = buffer_count * sizeof(struct io_uring_buf);
+    u->buf_ring = mmap(NULL, u->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->buf_ring == MAP_FAILED) {
+        u->buf_ring = NULL;
+        return -errno;
+    }
+
+    u->buf_data = malloc((size_t) buffer_count * buffer_size);
+    if (!u->buf_data) {
+        return -ENOMEM;
+    }
+
+    struct io_uring_buf_reg reg = {0};
+    reg.ring_addr    = (uint64_t) (uintptr_t) u->buf_ring;
+    reg.ring_entries = buffer_count;
+    reg.bgid         = BUFFER_GROUP;
+    if (sys_io_uring_register(u->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -errno;
+    }
+
+    u->buf_tail = 0;
+    for (unsigned bid = 0; bid < buffer_count; bid++) {
+        return_buffer(u, bid);
+    }
+    return 0;
+}
+
+int http_uring_init(http_uring_t *uring, int listen_fd, unsigned entries,
+                    unsigned buffer_count, unsigned buffer_size,
+                    http_uring_handler_t handler, void *user_data) {
+    assert(uring);
+    assert(handler);
+    assert(buffer_count > 0 && buffer_count <= 32768 && (buffer_count & (buffer_count - 1)) == 0);
+
+    memset(uring, 0, sizeof(*uring));
+    uring->ring_fd   = -1;
+    uring->listen_fd = listen_fd;
+    uring->handler   = handler;
+    uring->user_data = user_data;
+
+    // Only this thread uses the ring, so completions can be processed only when it asks for them
+    struct io_uring_params params = {0};
+    params.flags      = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = entries * 8;
+    uring->ring_fd = sys_io_uring_setup(entries, &params);
+    if (uring->ring_fd < 0 && errno == EINVAL) {
+        // Older kernel
+        memset(&params, 0, sizeof(params));
+        params.flags      = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 8;
+        uring->ring_fd = sys_io_uring_setup(entries, &params);
+    }
+    if (uring->ring_fd < 0) {
+        return -errno;
+    }
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        http_uring_destroy(uring);
+        return -ENOSYS;
+    }
+
+    int res = map_rings(uring, &params);
+    if (res == 0) {
+        res = register_buffers(uring, buffer_count, buffer_size);
+    }
+    if (res != 0) {
+        http_uring_destroy(uring);
+    }
+    return res;
+}
+
+int http_uring_run(http_uring_t *uring, atomic_bool *stopping) {
+    assert(uring);
+    assert(stopping);
+
+    arm_accept(uring);
+
+    while (!atomic_load_explicit(stopping, memory_order_relaxed)) {
+        int res = submit(uring, 1, 100 * 1000 * 1000);
+        if (res < 0 && res != -ETIME && res != -EINTR && res != -EBUSY) {
+            return res;
+        }
+        handle_completions(uring);
+    }
+    return 0;
+}
+
+void http_uring_destroy(http_uring_t *uring) {
+    assert(uring);
+
+    // Closing the ring cancels everything that's in flight, so connections can be freed right away
+    if (uring->ring_fd >= 0) {
+        close(uring->ring_fd);
+    }
+    while (uring->conns) {
+        http_uring_conn_t* next = uring->conns->next;
+        close(uring->conns->fd);
+        free(uring->conns);
+        uring->conns = next;
+    }
+
+    if (uring->sqes && uring->sqes != MAP_FAILED) {
+        munmap(uring->sqes, uring->sqes_size);
+    }
+    if (uring->cq_ring_ptr && uring->cq_ring_ptr != MAP_FAILED && uring->cq_ring_ptr != uring->sq_ring_ptr) {
+        munmap(uring->cq_ring_ptr, uring->cq_ring_size);
+    }
+    if (uring->sq_ring_ptr && uring->sq_ring_ptr != MAP_FAILED) {
+        munmap(uring->sq_ring_ptr, uring->sq_ring_size);
+    }
+    if (uring->buf_ring) {
+        munmap(uring->buf_ring, uring->buf_ring_size);
+    }
+    free(uring->buf_data);
+
+    memset(uring, 0, sizeof(*uring));
+    uring->ring_fd = -1;
+}
@@ -0,0 +1,101 @@
+#ifndef LIB_HTTP_URING_H
+#define LIB_HTTP_URING_H
+
+#include "http_parser.h"
+
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+
+/*
+ * HTTP/1.1 ingest over io_uring, without liburing. Connections are accepted with multishot accept
+ * and read with multishot recv into a ring of buffers provided to the kernel, so there is no read
+ * syscall per request and no buffer per connection. Requests are parsed directly in the buffer
+ * the kernel filled. Only a request that continues in the next buffer is copied, into the
+ * connection's own buffer, to be put together. Every buffer goes back to the kernel as soon as it's parsed.
+ */
+
+#define HTTP_URING_CONN_BUF_SIZE 16384
+#define HTTP_URING_MAX_RESPONSE  4096 /* largest response a handler can queue for one request */
+
+typedef struct http_uring_conn http_uring_conn_t;
+
+/*
+ * Called for every complete request of a connection, in order. The response is queued with
+ * http_uring_respond, at most HTTP_URING_MAX_RESPONSE bytes of it. Returning false closes the connection
+ * once queued responses are sent.
+ */
+typedef bool (*http_uring_handler_t)(void *user_data, http_uring_conn_t *conn, const http_request_t *req);
+
+typedef struct {
+    int ring_fd;
+
+    /* Submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail; /* entries filled in, but not yet made visible to the kernel */
+    unsigned sq_submitted;
+    struct io_uring_sqe *sqes;
+
+    /* Completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    /* Provided buffers */
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    char *buf_data;
+    unsigned buf_count;
+    unsigned buf_size;
+    uint16_t buf_tail;
+
+    int listen_fd;
+    http_uring_handler_t handler;
+    void *user_data;
+
+    http_uring_conn_t *conns; /* all open connections */
+
+    uint64_t requests;         /* requests parsed */
+    uint64_t reassembled;      /* of them, requests that spanned several buffers and were copied */
+} http_uring_t;
+
+/**
+ * Sets up a ring and buffer_count provided buffers of buffer_size bytes for connections accepted from listen_fd.
+ * buffer_count has to be a power of two, at most 32768.
+ *
+ * @return 0, or negative errno if io_uring isn't available
+ */
+int http_uring_init(http_uring_t *uring, int listen_fd, unsigned entries,
+                    unsigned buffer_count, unsigned buffer_size,
+                    http_uring_handler_t handler, void *user_data);
+
+/**
+ * Accepts connections and serves requests until *stopping is set. Checks it at least every 100 ms.
+ *
+ * @return 0, or negative errno on a ring error
+ */
+int http_uring_run(http_uring_t *uring, atomic_bool *stopping);
+
+/**
+ * Closes all connections and frees the ring.
+ */
+void http_uring_destroy(http_uring_t *uring);
+
+/**
+ * Queues response data of the request that is being handled.
+ *
+ * @return false if it's longer than what's left of HTTP_URING_MAX_RESPONSE for this request, nothing is queued then
+ */
+bool http_uring_respond(http_uring_conn_t *conn, const char *data, size_t len);
+
+#endif /* LIB_HTTP_URING_H */
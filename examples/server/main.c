@@ -0,0 +1,718 @@
+#define _GNU_SOURCE
+
+#include "http_parser.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(HAVE_IO_URING)
+#include "http_uring.h"
+#endif
+
+//
+// Reference HTTP/1.1 server: one thread per core, each with its own SO_REUSEPORT listener and
+// edge-triggered epoll loop, so the kernel spreads connections over threads and they share nothing.
+// Every request gets the same small response, so what's measured is I/O plus parsing.
+//
+// By default it also runs a closed-loop load generator over loopback for --duration seconds
+// and prints requests/s and latency percentiles. With --serve-only it just serves until Ctrl+C.
+//
+// With --io uring the server threads use io_uring instead of epoll (see http_uring.h),
+// the load generator stays the same, so the two can be compared.
+//
+// Usage: server [--threads N] [--clients N] [--connections N] [--duration S] [--warmup S]
+//               [--port P] [--pin] [--serve-only] [--io epoll|uring]
+//
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof(a[0]))
+
+#define CONN_BUF_SIZE 16384
+#define MAX_EVENTS    256
+#define MAX_HEADERS   64
+
+static const char response_ok[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 13\r\n"
+    "\r\n"
+    "Hello, World!";
+
+static const char response_bad_request[] =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static const char response_too_large[] =
+    "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static const char client_request[] =
+    "GET /plaintext HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: http_parser-loadgen\r\n"
+    "Accept: text/plain,*/*;q=0.8\r\n"
+    "\r\n";
+
+static atomic_bool stopping;
+static atomic_bool measuring;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static void die(const char* what) {
+    perror(what);
+    exit(1);
+}
+
+static void pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+//
+// Latency histogram with 16 sub-buckets per power of two, so values are kept with ~6% precision
+// and recording is a couple of instructions.
+//
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_BUCKETS  (64 << HISTOGRAM_SUB_BITS)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} histogram_t;
+
+static size_t histogram_bucket(uint64_t value) {
+    if (value < (1u << HISTOGRAM_SUB_BITS)) {
+        return (size_t) value;
+    }
+    unsigned exponent = 63 - (unsigned) __builtin_clzll(value);
+    unsigned shift = exponent - HISTOGRAM_SUB_BITS;
+    return ((size_t) (shift + 1) << HISTOGRAM_SUB_BITS) | (size_t) ((value >> shift) & ((1u << HISTOGRAM_SUB_BITS) - 1));
+}
+
+// Largest value that falls into bucket
+static uint64_t histogram_bucket_value(size_t bucket) {
+    if (bucket < (1u << HISTOGRAM_SUB_BITS)) {
+        return bucket;
+    }
+    unsigned shift = (unsigned) (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t mantissa = (1u << HISTOGRAM_SUB_BITS) | (bucket & ((1u << HISTOGRAM_SUB_BITS) - 1));
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static void histogram_record(histogram_t* h, uint64_t value) {
+    h->counts[histogram_bucket(value)]++;
+    h->total++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+static void histogram_merge(histogram_t* to, const histogram_t* from) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        to->counts[i] += from->counts[i];
+    }
+    to->total += from->total;
+    if (from->max > to->max) {
+        to->max = from->max;
+    }
+}
+
+static uint64_t histogram_percentile(const histogram_t* h, double percentile) {
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) h->total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t value = histogram_bucket_value(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Server
+
+typedef struct {
+    int fd;
+    bool close_after_write;
+
+    size_t in_len;
+    size_t out_len;
+    size_t out_sent;
+
+    char in[CONN_BUF_SIZE];
+    char out[CONN_BUF_SIZE];
+} connection_t;
+
+typedef struct {
+    int index;
+    uint16_t port;
+    bool pin;
+    bool uring;
+    int listen_fd;
+    pthread_t thread;
+} server_thread_t;
+
+static int create_listener(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        die("socket");
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        die("SO_REUSEPORT");
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        die("bind");
+    }
+    if (listen(fd, 4096) < 0) {
+        die("listen");
+    }
+    return fd;
+}
+
+static bool queue_output(connection_t* conn, const char* data, size_t len) {
+    if (len > sizeof(conn->out) - conn->out_len) {
+        return false;
+    }
+    memcpy(conn->out + conn->out_len, data, len);
+    conn->out_len += len;
+    return true;
+}
+
+//
+// Answers all complete requests in the input buffer (there can be several if the client pipelines).
+// Returns true if it stopped because the output buffer is full.
+//
+static bool process_requests(connection_t* conn) {
+    size_t offset = 0;
+    bool blocked = false;
+
+    while (offset < conn->in_len && !conn->close_after_write) {
+        http_header_t headers_buf[MAX_HEADERS];
+        http_request_t request;
+        size_t consumed;
+        http_parsing_result_t result = http_parse_request_framed(conn->in + offset, conn->in_len - offset,
+                                                                 headers_buf, ARRAY_LENGTH(headers_buf),
+                                                                 &request, &consumed);
+        if (result == PARSING_RES_NOT_ENOUGH_DATA) {
+            break;
+        }
+
+        if (result != PARSING_RES_SUCCEEDED) {
+            if (!queue_output(conn, response_bad_request, sizeof(response_bad_request) - 1)) {
+                blocked = true;
+                break;
+            }
+            conn->close_after_write = true;
+            offset = conn->in_len;
+            break;
+        }
+
+        if (!queue_output(conn, response_ok, sizeof(response_ok) - 1)) {
+            blocked = true;
+            break;
+        }
+
+        offset += consumed;
+        if (!request.info.keep_alive) {
+            conn->close_after_write = true;
+        }
+    }
+
+    memmove(conn->in, conn->in + offset, conn->in_len - offset);
+    conn->in_len -= offset;
+    return blocked;
+}
+
+// Returns false on error
+static bool flush_output(connection_t* conn) {
+    while (conn->out_sent < conn->out_len) {
+        ssize_t n = send(conn->fd, conn->out + conn->out_sent, conn->out_len - conn->out_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn->out_sent += (size_t) n;
+    }
+
+    conn->out_len = conn->out_sent = 0;
+    return true;
+}
+
+//
+// Called on every event of the connection. Epoll is edge-triggered, so this keeps reading
+// until the socket is drained (or the output can't be sent right now).
+// Returns false when the connection should be closed.
+//
+static bool serve_connection(connection_t* conn) {
+    for (;;) {
+        bool blocked = process_requests(conn);
+
+        if (!flush_output(conn)) {
+            return false;
+        }
+        if (conn->out_len > 0) {
+            // Wait for EPOLLOUT
+            return true;
+        }
+        if (conn->close_after_write) {
+            return false;
+        }
+        if (blocked) {
+            continue;
+        }
+
+        if (conn->in_len == sizeof(conn->in)) {
+            // A single request doesn't fit
+            queue_output(conn, response_too_large, sizeof(response_too_large) - 1);
+            conn->close_after_write = true;
+            conn->in_len = 0;
+            continue;
+        }
+
+        ssize_t n = recv(conn->fd, conn->in + conn->in_len, sizeof(conn->in) - conn->in_len, 0);
+        if (n > 0) {
+            conn->in_len += (size_t) n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+static void close_connection(connection_t* conn) {
+    close(conn->fd);
+    free(conn);
+}
+
+static void accept_connections(int epoll_fd, int listen_fd) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        connection_t* conn = malloc(sizeof(connection_t));
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->close_after_write = false;
+        conn->in_len = conn->out_len = conn->out_sent = 0;
+
+        struct epoll_event event = {0};
+        event.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close_connection(conn);
+        }
+    }
+}
+
+#if defined(HAVE_IO_URING)
+static bool handle_uring_request(void* user_data, http_uring_conn_t* conn, const http_request_t* req) {
+    (void) user_data;
+    if (!http_uring_respond(conn, response_ok, sizeof(response_ok) - 1)) {
+        return false;
+    }
+    return req->info.keep_alive;
+}
+
+static void serve_with_uring(server_thread_t* self) {
+    http_uring_t uring;
+    int res = http_uring_init(&uring, self->listen_fd, 256, 1024, 4096, handle_uring_request, NULL);
+    if (res < 0) {
+        errno = -res;
+        die("http_uring_init");
+    }
+
+    res = http_uring_run(&uring, &stopping);
+    if (res < 0) {
+        errno = -res;
+        die("http_uring_run");
+    }
+
+    if (self->index == 0) {
+        printf("io_uring: %llu requests, %llu spanned buffers and were copied\n",
+               (unsigned long long) uring.requests, (unsigned long long) uring.reassembled);
+    }
+    http_uring_destroy(&uring);
+}
+#endif
+
+static void* server_thread_main(void* arg) {
+    server_thread_t* self = arg;
+    if (self->pin) {
+        pin_to_cpu(self->index);
+    }
+
+#if defined(HAVE_IO_URING)
+    if (self->uring) {
+        serve_with_uring(self);
+        return NULL;
+    }
+#endif
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        die("epoll_create1");
+    }
+
+    // Listener has NULL as data, connections have their connection_t
+    struct epoll_event event = {0};
+    event.events   = EPOLLIN | EPOLLET;
+    event.data.ptr = NULL;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, self->listen_fd, &event) < 0) {
+        die("epoll_ctl");
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (!atomic_load_explicit(&stopping, memory_order_relaxed)) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++) {
+            connection_t* conn = events[i].data.ptr;
+            if (!conn) {
+                accept_connections(epoll_fd, self->listen_fd);
+                continue;
+            }
+
+            if ((events[i].events & EPOLLERR) || !serve_connection(conn)) {
+                close_connection(conn);
+            }
+        }
+    }
+
+    // Connections that are still open are left to the OS, the process is about to exit
+    close(epoll_fd);
+    return NULL;
+}
+
+// Load generator
+
+typedef struct {
+    int fd;
+    uint64_t sent_at;
+    size_t in_len;
+    char in[CONN_BUF_SIZE];
+} client_connection_t;
+
+typedef struct {
+    int index;
+    uint16_t port;
+    int connections;
+    pthread_t thread;
+
+    histogram_t latency;
+    uint64_t errors;
+} client_thread_t;
+
+static int connect_to_server(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        die("socket");
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        die("connect");
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static bool send_request(client_connection_t* conn) {
+    conn->sent_at = now_ns();
+    // Small enough to always fit into an empty socket buffer
+    ssize_t n = send(conn->fd, client_request, sizeof(client_request) - 1, MSG_NOSIGNAL);
+    return n == (ssize_t) (sizeof(client_request) - 1);
+}
+
+// Reads responses, records their latency and sends the next request. Returns false on error.
+static bool client_receive(client_thread_t* self, client_connection_t* conn) {
+    for (;;) {
+        ssize_t n = recv(conn->fd, conn->in + conn->in_len, sizeof(conn->in) - conn->in_len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        conn->in_len += (size_t) n;
+
+        http_header_t headers_buf[MAX_HEADERS];
+        http_response_t response;
+        size_t consumed;
+        http_parsing_result_t result = http_parse_response_framed(conn->in, conn->in_len,
+                                                                  headers_buf, ARRAY_LENGTH(headers_buf),
+                                                                  &response, &consumed);
+        if (result == PARSING_RES_NOT_ENOUGH_DATA) {
+            continue;
+        }
+        if (result != PARSING_RES_SUCCEEDED || response.status_code != 200) {
+            return false;
+        }
+
+        if (atomic_load_explicit(&measuring, memory_order_relaxed)) {
+            histogram_record(&self->latency, now_ns() - conn->sent_at);
+        }
+
+        memmove(conn->in, conn->in + consumed, conn->in_len - consumed);
+        conn->in_len -= consumed;
+
+        if (!send_request(conn)) {
+            return false;
+        }
+    }
+}
+
+static void* client_thread_main(void* arg) {
+    client_thread_t* self = arg;
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        die("epoll_create1");
+    }
+
+    client_connection_t* conns = calloc((size_t) self->connections, sizeof(client_connection_t));
+    if (!conns) {
+        die("calloc");
+    }
+
+    for (int i = 0; i < self->connections; i++) {
+        client_connection_t* conn = &conns[i];
+        conn->fd = connect_to_server(self->port);
+
+        struct epoll_event event = {0};
+        event.events   = EPOLLIN | EPOLLET;
+        event.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn->fd, &event) < 0) {
+            die("epoll_ctl");
+        }
+
+        // Connected blocking so it's simpler, the rest is non-blocking
+        if (fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL) | O_NONBLOCK) < 0) {
+            die("fcntl");
+        }
+
+        if (!send_request(conn)) {
+            die("send");
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (!atomic_load_explicit(&stopping, memory_order_relaxed)) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++) {
+            client_connection_t* conn = events[i].data.ptr;
+            if (conn->fd < 0) {
+                continue;
+            }
+            if (!client_receive(self, conn)) {
+                self->errors++;
+                close(conn->fd);
+                conn->fd = -1;
+            }
+        }
+    }
+
+    for (int i = 0; i < self->connections; i++) {
+        if (conns[i].fd >= 0) {
+            close(conns[i].fd);
+        }
+    }
+    free(conns);
+    close(epoll_fd);
+    return NULL;
+}
+
+static void handle_sigint(int sig) {
+    (void) sig;
+    atomic_store(&stopping, true);
+}
+
+int main(int argc, char* argv[]) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_servers = num_cpus > 0 ? (int) num_cpus : 1;
+    int num_clients = num_servers;
+    int connections = 64;
+    double duration = 5.0;
+    double warmup = 1.0;
+    uint16_t port = 0;
+    bool pin = false;
+    bool serve_only = false;
+    bool uring = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_servers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            num_clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+            connections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = (uint16_t) atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            pin = true;
+        } else if (strcmp(argv[i], "--serve-only") == 0) {
+            serve_only = true;
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc && strcmp(argv[i + 1], "epoll") == 0) {
+            uring = false;
+            i++;
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc && strcmp(argv[i + 1], "uring") == 0) {
+#if defined(HAVE_IO_URING)
+            uring = true;
+            i++;
+#else
+            fprintf(stderr, "Built without io_uring\n");
+            return 1;
+#endif
+        } else {
+            fprintf(stderr, "Usage: %s [--threads N] [--clients N] [--connections N] [--duration S] [--warmup S]\n"
+                            "          [--port P] [--pin] [--serve-only] [--io epoll|uring]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_servers < 1 || num_clients < 1 || connections < 1) {
+        fprintf(stderr, "Thread and connection counts have to be positive\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    // Every thread gets its own listener on the same port, the kernel balances connections between them
+    server_thread_t* servers = calloc((size_t) num_servers, sizeof(server_thread_t));
+    for (int i = 0; i < num_servers; i++) {
+        servers[i].index     = i;
+        servers[i].pin       = pin;
+        servers[i].uring     = uring;
+        servers[i].listen_fd = create_listener(port);
+
+        if (port == 0) {
+            struct sockaddr_in addr;
+            socklen_t addr_len = sizeof(addr);
+            getsockname(servers[i].listen_fd, (struct sockaddr*) &addr, &addr_len);
+            port = ntohs(addr.sin_port);
+        }
+        servers[i].port = port;
+    }
+    for (int i = 0; i < num_servers; i++) {
+        pthread_create(&servers[i].thread, NULL, server_thread_main, &servers[i]);
+    }
+
+    printf("Listening on 127.0.0.1:%u with %d threads (%s)\n", port, num_servers, uring ? "io_uring" : "epoll");
+    fflush(stdout);
+
+    if (serve_only) {
+        signal(SIGINT, handle_sigint);
+        signal(SIGTERM, handle_sigint);
+        while (!atomic_load(&stopping)) {
+            pause();
+        }
+    } else {
+        client_thread_t* clients = calloc((size_t) num_clients, sizeof(client_thread_t));
+        for (int i = 0; i < num_clients; i++) {
+            clients[i].index       = i;
+            clients[i].port        = port;
+            clients[i].connections = connections;
+            pthread_create(&clients[i].thread, NULL, client_thread_main, &clients[i]);
+        }
+
+        struct timespec warmup_ts = {(time_t) warmup, (long) ((warmup - (double) (time_t) warmup) * 1e9)};
+        nanosleep(&warmup_ts, NULL);
+
+        atomic_store(&measuring, true);
+        uint64_t start = now_ns();
+
+        struct timespec duration_ts = {(time_t) duration, (long) ((duration - (double) (time_t) duration) * 1e9)};
+        nanosleep(&duration_ts, NULL);
+
+        atomic_store(&measuring, false);
+        double elapsed = (double) (now_ns() - start) * 1e-9;
+        atomic_store(&stopping, true);
+
+        static histogram_t latency;
+        uint64_t errors = 0;
+        for (int i = 0; i < num_clients; i++) {
+            pthread_join(clients[i].thread, NULL);
+            histogram_merge(&latency, &clients[i].latency);
+            errors += clients[i].errors;
+        }
+        free(clients);
+
+        printf("Load: %d client threads x %d connections, %.1f s\n", num_clients, connections, elapsed);
+        printf("Requests: %llu, %.0f req/s, %llu errors\n",
+               (unsigned long long) latency.total, (double) latency.total / elapsed, (unsigned long long) errors);
+        printf("Latency: p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us\n",
+               (double) histogram_percentile(&latency, 50.0) / 1e3,
+               (double) histogram_percentile(&latency, 99.0) / 1e3,
+               (double) histogram_percentile(&latency, 99.9) / 1e3,
+               (double) latency.max / 1e3);
+    }
+
+    atomic_store(&stopping, true);
+    for (int i = 0; i < num_servers; i++) {
+        pthread_join(servers[i].thread, NULL);
+        close(servers[i].listen_fd);
+    }
+    free(servers);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/* Generated by tools/gen_header_ids.py, don't edit. */
+
+#ifndef LIB_HTTP_HEADER_IDS_H
+#define LIB_HTTP_HEADER_IDS_H
+
+/* Ids of well-known header names (permanent entries of the IANA HTTP Field Name Registry). */
+typedef enum {
+    HTTP_HEADER_UNKNOWN,
+    HTTP_HEADER_A_IM,
+    HTTP_HEADER_ACCEPT,
+    HTTP_HEADER_ACCEPT_CHARSET,
+    HTTP_HEADER_ACCEPT_ENCODING,
+    HTTP_HEADER_ACCEPT_LANGUAGE,
+    HTTP_HEADER_ACCEPT_PATCH,
+    HTTP_HEADER_ACCEPT_POST,
+    HTTP_HEADER_ACCEPT_RANGES,
+    HTTP_HEADER_ACCESS_CONTROL_ALLOW_CREDENTIALS,
+    HTTP_HEADER_ACCESS_CONTROL_ALLOW_HEADERS,
+    HTTP_HEADER_ACCESS_CONTROL_ALLOW_METHODS,
+    HTTP_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN,
+    HTTP_HEADER_ACCESS_CONTROL_EXPOSE_HEADERS,
+    HTTP_HEADER_ACCESS_CONTROL_MAX_AGE,
+    HTTP_HEADER_ACCESS_CONTROL_REQUEST_HEADERS,
+    HTTP_HEADER_ACCESS_CONTROL_REQUEST_METHOD,
+    HTTP_HEADER_AGE,
+    HTTP_HEADER_ALLOW,
+    HTTP_HEADER_ALT_SVC,
+    HTTP_HEADER_AUTHORIZATION,
+    HTTP_HEADER_CACHE_CONTROL,
+    HTTP_HEADER_CLEAR_SITE_DATA,
+    HTTP_HEADER_CONNECTION,
+    HTTP_HEADER_CONTENT_DIGEST,
+    HTTP_HEADER_CONTENT_DISPOSITION,
+    HTTP_HEADER_CONTENT_ENCODING,
+    HTTP_HEADER_CONTENT_LANGUAGE,
+    HTTP_HEADER_CONTENT_LENGTH,
+    HTTP_HEADER_CONTENT_LOCATION,
+    HTTP_HEADER_CONTENT_RANGE,
+    HTTP_HEADER_CONTENT_SECURITY_POLICY,
+    HTTP_HEADER_CONTENT_SECURITY_POLICY_REPORT_ONLY,
+    HTTP_HEADER_CONTENT_TYPE,
+    HTTP_HEADER_COOKIE,
+    HTTP_HEADER_CROSS_ORIGIN_EMBEDDER_POLICY,
+    HTTP_HEADER_CROSS_ORIGIN_OPENER_POLICY,
+    HTTP_HEADER_CROSS_ORIGIN_RESOURCE_POLICY,
+    HTTP_HEADER_DATE,
+    HTTP_HEADER_EARLY_DATA,
+    HTTP_HEADER_ETAG,
+    HTTP_HEADER_EXPECT,
+    HTTP_HEADER_EXPIRES,
+    HTTP_HEADER_FORWARDED,
+    HTTP_HEADER_FROM,
+    HTTP_HEADER_HOST,
+    HTTP_HEADER_IF_MATCH,
+    HTTP_HEADER_IF_MODIFIED_SINCE,
+    HTTP_HEADER_IF_NONE_MATCH,
+    HTTP_HEADER_IF_RANGE,
+    HTTP_HEADER_IF_UNMODIFIED_SINCE,
+    HTTP_HEADER_KEEP_ALIVE,
+    HTTP_HEADER_LAST_MODIFIED,
+    HTTP_HEADER_LINK,
+    HTTP_HEADER_LOCATION,
+    HTTP_HEADER_MAX_FORWARDS,
+    HTTP_HEADER_ORIGIN,
+    HTTP_HEADER_PRAGMA,
+    HTTP_HEADER_PREFER,
+    HTTP_HEADER_PREFERENCE_APPLIED,
+    HTTP_HEADER_PRIORITY,
+    HTTP_HEADER_PROXY_AUTHENTICATE,
+    HTTP_HEADER_PROXY_AUTHORIZATION,
+    HTTP_HEADER_RANGE,
+    HTTP_HEADER_REFERER,
+    HTTP_HEADER_REFERRER_POLICY,
+    HTTP_HEADER_REFRESH,
+    HTTP_HEADER_RETRY_AFTER,
+    HTTP_HEADER_SEC_FETCH_DEST,
+    HTTP_HEADER_SEC_FETCH_MODE,
+    HTTP_HEADER_SEC_FETCH_SITE,
+    HTTP_HEADER_SEC_FETCH_USER,
+    HTTP_HEADER_SEC_PURPOSE,
+    HTTP_HEADER_SEC_WEBSOCKET_ACCEPT,
+    HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS,
+    HTTP_HEADER_SEC_WEBSOCKET_KEY,
+    HTTP_HEADER_SEC_WEBSOCKET_PROTOCOL,
+    HTTP_HEADER_SEC_WEBSOCKET_VERSION,
+    HTTP_HEADER_SERVER,
+    HTTP_HEADER_SERVER_TIMING,
+    HTTP_HEADER_SET_COOKIE,
+    HTTP_HEADER_STRICT_TRANSPORT_SECURITY,
+    HTTP_HEADER_TE,
+    HTTP_HEADER_TIMING_ALLOW_ORIGIN,
+    HTTP_HEADER_TRAILER,
+    HTTP_HEADER_TRANSFER_ENCODING,
+    HTTP_HEADER_UPGRADE,
+    HTTP_HEADER_UPGRADE_INSECURE_REQUESTS,
+    HTTP_HEADER_USER_AGENT,
+    HTTP_HEADER_VARY,
+    HTTP_HEADER_VIA,
+    HTTP_HEADER_WWW_AUTHENTICATE,
+    HTTP_HEADER_WANT_CONTENT_DIGEST,
+    HTTP_HEADER_X_CONTENT_TYPE_OPTIONS,
+    HTTP_HEADER_X_FRAME_OPTIONS,
+
+    HTTP_HEADER_COUNT,
+} http_header_id_t;
+
+#endif /* LIB_HTTP_HEADER_IDS_H */
@@ -5,11 +5,23 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "http_header_ids.h"
+
+#if defined(_WIN32)
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
 typedef enum {
     PARSING_RES_SUCCEEDED,
     PARSING_RES_NOT_ENOUGH_MEMORY,
     PARSING_RES_NOT_ENOUGH_DATA,
     PARSING_RES_FAILED,
+    PARSING_RES_STOPPED,
 } http_parsing_result_t;
 
 static const char* translate_http_parsing_result(http_parsing_result_t result) {
@@ -18,10 +30,54 @@ static const char* translate_http_parsing_result(http_parsing_result_t result) {
         case PARSING_RES_NOT_ENOUGH_MEMORY: return "PARSING_RES_NOT_ENOUGH_MEMORY";
         case PARSING_RES_NOT_ENOUGH_DATA:   return "PARSING_RES_NOT_ENOUGH_DATA";
         case PARSING_RES_FAILED:            return "PARSING_RES_FAILED";
+        case PARSING_RES_STOPPED:           return "PARSING_RES_STOPPED";
     }
     return "unknown";
 }
 
+/*
+ * Instruction set tiers of the scanning code. By default the best one the CPU supports is picked at startup.
+ */
+typedef enum {
+    HTTP_PARSER_IMPL_AUTO,
+    HTTP_PARSER_IMPL_SCALAR,
+    HTTP_PARSER_IMPL_SSE2,
+    HTTP_PARSER_IMPL_SSE42,
+    HTTP_PARSER_IMPL_AVX2,
+    HTTP_PARSER_IMPL_AVX512,
+} http_parser_impl_t;
+
+static const char* translate_http_parser_impl(http_parser_impl_t impl) {
+    switch (impl) {
+        case HTTP_PARSER_IMPL_AUTO:   return "auto";
+        case HTTP_PARSER_IMPL_SCALAR: return "scalar";
+        case HTTP_PARSER_IMPL_SSE2:   return "sse2";
+        case HTTP_PARSER_IMPL_SSE42:  return "sse4.2";
+        case HTTP_PARSER_IMPL_AVX2:   return "avx2";
+        case HTTP_PARSER_IMPL_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+/**
+ * Checks whether impl is compiled in and supported by the CPU. HTTP_PARSER_IMPL_AUTO and HTTP_PARSER_IMPL_SCALAR always are.
+ */
+bool http_parser_impl_supported(http_parser_impl_t impl);
+
+/**
+ * Forces the scanning code to use impl (mostly for testing and benchmarking),
+ * HTTP_PARSER_IMPL_AUTO goes back to the best supported one. Affects all threads,
+ * so it shouldn't be called while something is being parsed.
+ *
+ * @return false if impl isn't supported, nothing is changed then
+ */
+bool http_parser_set_impl(http_parser_impl_t impl);
+
+/**
+ * Returns the tier that is currently used (never HTTP_PARSER_IMPL_AUTO).
+ */
+http_parser_impl_t http_parser_get_impl(void);
+
 /* We don't separate different types of headers (General/Response/Representation) */
 typedef struct {
     const char *name;
@@ -29,8 +85,79 @@ typedef struct {
 
     const char *value;
     size_t value_len;
+
+    http_header_id_t id; /* HTTP_HEADER_UNKNOWN if name isn't one of the well-known ones */
 } http_header_t;
 
+/*
+ * Header stored as offsets from the start of the message instead of pointers, 8 bytes instead of 32.
+ * Pointers are rebuilt with http_compact_header_name/http_compact_header_value.
+ */
+typedef struct {
+    uint32_t offset;    /* offset of the name */
+    uint16_t name_len;
+    uint16_t value_len; /* value starts after the colon and whitespace that follow the name */
+} http_compact_header_t;
+
+/**
+ * Finds id of a well-known header name, case-insensitive. Same as the id that is filled in by parsing.
+ *
+ * @return HTTP_HEADER_UNKNOWN if name isn't one of the well-known ones
+ */
+http_header_id_t http_header_id_lookup(const char *name, size_t name_len);
+
+/**
+ * Returns canonical spelling of a well-known header name, "" for HTTP_HEADER_UNKNOWN.
+ */
+const char *http_header_id_name(http_header_id_t id);
+
+/*
+ * Hash index of headers by name, so looking a header up doesn't depend on the number of headers.
+ * Built while parsing in storage provided by the caller, nothing is allocated.
+ */
+typedef struct {
+    uint32_t *slots;  /* index of header + 1 in the low 16 bits, part of hash of its name in the high 16 bits; 0 is empty */
+    size_t slots_len; /* power of two, twice the expected number of headers is enough */
+    size_t count;     /* number of indexed headers */
+    bool overflowed;  /* more headers than fit, lookups fall back to scanning all headers */
+} http_header_index_t;
+
+/**
+ * Prepares index that uses slots as its storage. slots_len has to be a power of two.
+ */
+void http_header_index_init(http_header_index_t *index, uint32_t *slots, size_t slots_len);
+
+/*
+ * What the headers say about framing and the connection, collected while they are parsed,
+ * so nobody has to go over them again.
+ */
+typedef struct {
+    uint64_t content_length; /* if has_content_length */
+    bool has_content_length;
+    bool has_transfer_encoding;
+    bool chunked; /* last transfer coding is chunked */
+
+    /* Tokens of Connection */
+    bool connection_close;
+    bool connection_keep_alive;
+    bool connection_upgrade;
+
+    /* Connection can be used for another message: HTTP/1.1 unless "close", HTTP/1.0 only with "keep-alive".
+       Never for a response that lasts until the connection is closed, or a request with unknown length. */
+    bool keep_alive;
+
+    const char *upgrade; /* value of Upgrade, NULL if there's none */
+    size_t upgrade_len;
+    bool upgrade_requested; /* Upgrade together with "upgrade" in Connection */
+
+    bool expect_continue; /* Expect: 100-continue */
+
+    /* Framing problems, which are often signs of request smuggling */
+    bool invalid_content_length;   /* not a number, or repeated with different values */
+    bool duplicate_content_length; /* repeated with the same value */
+    bool length_conflict;          /* both Content-Length and Transfer-Encoding */
+} http_message_info_t;
+
 typedef struct {
     const char *protocol;
     size_t protocol_len;
@@ -45,6 +172,10 @@ typedef struct {
 
     const char *body;
     size_t body_len;
+
+    const http_header_index_t *header_index; /* NULL if headers weren't indexed */
+
+    http_message_info_t info; /* complete once all headers are parsed */
 } http_response_t;
 
 /**
@@ -80,6 +211,10 @@ typedef struct {
 
     const char *body;
     size_t body_len;
+
+    const http_header_index_t *header_index; /* NULL if headers weren't indexed */
+
+    http_message_info_t info; /* complete once all headers are parsed */
 } http_request_t;
 
 /**
@@ -100,9 +235,725 @@ http_parsing_result_t http_parse_request(const char *text, size_t text_len,
                                          http_header_t *headers_buf, size_t headers_max_len,
                                          http_request_t *out_req);
 
+/**
+ * Parses n independent requests, e.g. from different connections, each like http_parse_request.
+ * They are parsed in turns of one line each instead of one after another. With hot or cold buffers
+ * this is about as fast as calling http_parse_request for each of them (see the bench), not faster.
+ *
+ * @param[in] texts, text_lens - n input buffers
+ * @param[in] headers_pool - n * headers_per_request headers, request i gets headers_per_request of them from i * headers_per_request
+ * @param[out] out_reqs - n requests
+ * @param[out] out_results - result of every request, the same as http_parse_request would return
+ *
+ * @return number of requests that succeeded
+ */
+size_t http_parse_requests_multi(const char *const *texts, const size_t *text_lens, size_t n,
+                                 http_header_t *headers_pool, size_t headers_per_request,
+                                 http_request_t *out_reqs, http_parsing_result_t *out_results);
+
+/**
+ * Same as http_parse_response, but the body ends where the message ends instead of at the end of text,
+ * so several responses in one buffer can be split. The length of the body comes from
+ * Transfer-Encoding/Content-Length (RFC 9112 section 6.3). Responses to HEAD requests aren't recognized.
+ *
+ * Chunked body is left encoded (including the last chunk), it can be decoded with http_decode_chunked.
+ * When the length isn't known, the response lasts until the connection is closed,
+ * then all of the remaining text is the body.
+ *
+ * @param[out] out_consumed - size of the whole message including the body; next message starts there
+ *
+ * @retval PARSING_RES_NOT_ENOUGH_DATA - also when the body hasn't arrived completely
+ * @retval PARSING_RES_FAILED - also when Content-Length is invalid or repeated with different values
+ */
+http_parsing_result_t http_parse_response_framed(const char *text, size_t text_len,
+                                                 http_header_t *headers_buf, size_t headers_max_len,
+                                                 http_response_t *out_resp, size_t *out_consumed);
+
+/**
+ * Same as http_parse_request, but the body ends where the message ends. See http_parse_response_framed.
+ * Requests without Content-Length and Transfer-Encoding have no body.
+ */
+http_parsing_result_t http_parse_request_framed(const char *text, size_t text_len,
+                                                http_header_t *headers_buf, size_t headers_max_len,
+                                                http_request_t *out_req, size_t *out_consumed);
+
+/**
+ * Parses all complete pipelined requests in a buffer at once, framed like with http_parse_request_framed.
+ * Headers of all requests are taken one after another from a shared pool.
+ *
+ * @param[in] text, text_len - input buffer with any number of HTTP requests
+ * @param[in] headers_pool - pre-allocated array of headers structures shared by all requests
+ * @param[in] pool_len - size of headers_pool array
+ * @param[out] out_reqs - array of structures that will be filled with data from HTTP requests
+ * @param[in] max_reqs - size of out_reqs array
+ * @param[out] out_count - number of requests written to out_reqs
+ * @param[out] out_consumed - size of all parsed requests; the rest of the buffer (if any)
+ *                            is an incomplete request, or one that didn't fit
+ *
+ * @return error code of parsing
+ * @retval PARSING_RES_SUCCEEDED - at least one request is parsed, parsing stopped at the end of text,
+ *                                 at an incomplete request or because out_reqs/headers_pool is full
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - the first request didn't fit into out_reqs/headers_pool
+ * @retval PARSING_RES_NOT_ENOUGH_DATA - there's not a single complete request
+ * @retval PARSING_RES_FAILED - a request after the first out_count ones is invalid;
+ *                              the out_count requests before it are still valid
+ */
+http_parsing_result_t http_parse_requests_batch(const char *text, size_t text_len,
+                                                http_header_t *headers_pool, size_t pool_len,
+                                                http_request_t *out_reqs, size_t max_reqs,
+                                                size_t *out_count, size_t *out_consumed);
+
+/*
+ * Callbacks that receive parts of a message as soon as they are parsed, instead of filling
+ * http_request_t/http_response_t. All of them are optional. Pointers point into the parsed text.
+ * Returning nonzero stops parsing, the parse function then returns PARSING_RES_STOPPED.
+ */
+typedef struct {
+    int (*on_method)(void *user_data, const char *method, size_t method_len);
+    int (*on_target)(void *user_data, const char *target, size_t target_len);
+    int (*on_status)(void *user_data, uint16_t status_code, const char *status_text, size_t status_text_len);
+    int (*on_header)(void *user_data, const http_header_t *header);
+    int (*on_headers_complete)(void *user_data);
+    int (*on_body)(void *user_data, const char *body, size_t body_len); /* not called if there's no body */
+} http_parser_callbacks_t;
+
+/**
+ * Parses HTTP response like http_parse_response, but passes its parts to callbacks.
+ * Headers aren't stored anywhere, so there's no limit on their number.
+ *
+ * @param[in] text, text_len - input buffer with HTTP response text
+ * @param[in] callbacks - functions to call, any of them can be NULL
+ * @param[in] user_data - passed to every callback
+ *
+ * @return error code of parsing, same as http_parse_response. Callbacks are called for everything
+ *         parsed before an error, and when PARSING_RES_NOT_ENOUGH_DATA is returned.
+ * @retval PARSING_RES_STOPPED - a callback returned nonzero
+ */
+http_parsing_result_t http_parse_response_cb(const char *text, size_t text_len,
+                                             const http_parser_callbacks_t *callbacks, void *user_data);
+
+/**
+ * Same as http_parse_request with callbacks. See http_parse_response_cb.
+ */
+http_parsing_result_t http_parse_request_cb(const char *text, size_t text_len,
+                                            const http_parser_callbacks_t *callbacks, void *user_data);
+
+/*
+ * Called when the arena is full. Returns a new block of at least min_size bytes and its size,
+ * or NULL to make the allocation fail. The block has to be aligned for a pointer, its start is used
+ * to link it to the other blocks. The arena continues in the new block, previous blocks
+ * still hold earlier allocations until the arena is reset.
+ */
+typedef void *(*http_arena_grow_t)(void *user_data, size_t min_size, size_t *out_size);
 
+/*
+ * Called by http_arena_reset for every block that grow returned, with the size grow reported.
+ */
+typedef void (*http_arena_release_t)(void *user_data, void *block, size_t size);
+
+/*
+ * Bump allocator over memory provided by the caller. Everything is freed at once with http_arena_reset.
+ */
+typedef struct {
+    char *data; /* current block */
+    size_t size;
+    size_t used;
+
+    char *initial_data; /* memory given to http_arena_init, where the arena starts again after reset */
+    size_t initial_size;
+    void *blocks;       /* blocks from grow, the newest first */
+
+    http_arena_grow_t grow;       /* optional */
+    http_arena_release_t release; /* optional, without it grown blocks are forgotten on reset */
+    void *user_data;
+} http_arena_t;
+
+/**
+ * Prepares arena that allocates from data. grow can be NULL, then allocations fail once data is full.
+ */
+void http_arena_init(http_arena_t *arena, void *data, size_t size,
+                     http_arena_grow_t grow, http_arena_release_t release, void *user_data);
+
+/**
+ * Allocates size bytes aligned to align (a power of two).
+ *
+ * @return NULL if there's not enough memory and grow didn't provide more
+ */
+void *http_arena_alloc(http_arena_t *arena, size_t size, size_t align);
+
+/**
+ * Frees everything, e.g. before parsing the next request of a connection. Blocks from grow are handed
+ * to release and the arena continues in the memory it was initialized with.
+ */
+void http_arena_reset(http_arena_t *arena);
+
+/**
+ * Same as http_parse_response, but the header array is allocated from arena. When it's full it grows
+ * in the arena and parsing continues, so there's no need to parse again with a bigger array.
+ * out_resp->headers stays valid until the arena is reset.
+ *
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - arena is full and its grow callback didn't provide more memory
+ */
+http_parsing_result_t http_parse_response_arena(const char *text, size_t text_len,
+                                                http_arena_t *arena, http_response_t *out_resp);
+
+/**
+ * Same as http_parse_request with header array allocated from arena. See http_parse_response_arena.
+ */
+http_parsing_result_t http_parse_request_arena(const char *text, size_t text_len,
+                                               http_arena_t *arena, http_request_t *out_req);
+
+typedef enum {
+    HTTP_PARSER_STAGE_START_LINE,
+    HTTP_PARSER_STAGE_HEADERS,
+    HTTP_PARSER_STAGE_DONE,
+} http_parser_stage_t;
+
+/*
+ * Progress of incremental parsing of one message. Offsets are relative to the start of the message.
+ */
+typedef struct {
+    http_parser_stage_t stage;
+
+    size_t offset;      /* first byte that wasn't consumed yet (start of the current line, or of the body) */
+    size_t scanned;     /* bytes of the current line that were already searched for a newline */
+    size_t headers_len; /* number of headers already written to headers_buf */
+
+    http_header_index_t *index; /* optional, if set after http_parser_state_init headers are indexed while parsed */
+} http_parser_state_t;
+
+/**
+ * Prepares state for parsing a new message with http_parse_request_continue/http_parse_response_continue.
+ */
+void http_parser_state_init(http_parser_state_t *state);
+
+/**
+ * Incremental version of http_parse_response. Call it again with the same state every time more data
+ * is appended to text. Lines that were already parsed aren't parsed again, so every byte is scanned once.
+ *
+ * @param[in,out] state - progress of parsing, initialized with http_parser_state_init
+ * @param[in] text, text_len - everything received so far. Must start at the same byte and keep
+ *                             the same contents on every call. If the buffer moves (e.g. realloc),
+ *                             fields already filled in out_resp and headers_buf still point into the
+ *                             old buffer, so restart with a fresh state.
+ * @param[in] headers_buf - same as in http_parse_response. Headers parsed by previous calls must be kept,
+ *                          so after PARSING_RES_NOT_ENOUGH_MEMORY a bigger copy of it can be passed
+ * @param[in] headers_max_len - size of headers_buf array
+ * @param[in,out] out_resp - structure that is filled with data from HTTP response. Must be the same between calls
+ *
+ * @return error code of parsing, same as http_parse_response
+ */
+http_parsing_result_t http_parse_response_continue(http_parser_state_t *state,
+                                                   const char *text, size_t text_len,
+                                                   http_header_t *headers_buf, size_t headers_max_len,
+                                                   http_response_t *out_resp);
+
+/**
+ * Incremental version of http_parse_request. See http_parse_response_continue.
+ */
+http_parsing_result_t http_parse_request_continue(http_parser_state_t *state,
+                                                  const char *text, size_t text_len,
+                                                  http_header_t *headers_buf, size_t headers_max_len,
+                                                  http_request_t *out_req);
+
+/**
+ * Same as http_parse_response, but headers are stored in the compact form. Fields of out_resp
+ * except headers/headers_len are filled as usual, header_index isn't used.
+ *
+ * @param[in] headers_buf - pre-allocated array of compact headers, offsets are relative to text
+ * @param[out] out_headers_len - number of headers written to headers_buf
+ *
+ * @retval PARSING_RES_FAILED - also when a header doesn't fit into http_compact_header_t
+ *                              (name or value longer than 65535 bytes, or message longer than 4 GiB)
+ */
+http_parsing_result_t http_parse_response_compact(const char *text, size_t text_len,
+                                                  http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                  http_response_t *out_resp, size_t *out_headers_len);
+
+/**
+ * Same as http_parse_request with compact headers. See http_parse_response_compact.
+ */
+http_parsing_result_t http_parse_request_compact(const char *text, size_t text_len,
+                                                 http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                 http_request_t *out_req, size_t *out_headers_len);
+
+/**
+ * Incremental version of http_parse_response_compact, see http_parse_response_continue.
+ * The number of headers written to headers_buf is state->headers_len, state->index isn't used.
+ */
+http_parsing_result_t http_parse_response_compact_continue(http_parser_state_t *state,
+                                                           const char *text, size_t text_len,
+                                                           http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                           http_response_t *out_resp);
+
+/**
+ * Incremental version of http_parse_request_compact, see http_parse_response_compact_continue.
+ */
+http_parsing_result_t http_parse_request_compact_continue(http_parser_state_t *state,
+                                                          const char *text, size_t text_len,
+                                                          http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                          http_request_t *out_req);
+
+/**
+ * Returns the name of a compact header, text is the message it was parsed from.
+ */
+const char *http_compact_header_name(const char *text, const http_compact_header_t *header);
+
+/**
+ * Returns the value of a compact header, text is the message it was parsed from.
+ */
+const char *http_compact_header_value(const char *text, const http_compact_header_t *header);
+
+/**
+ * Converts a compact header back to http_header_t, including its id.
+ */
+void http_compact_header_expand(const char *text, const http_compact_header_t *header, http_header_t *out_header);
+
+/**
+ * Decodes body with "Transfer-Encoding: chunked" into buf. Chunk extensions and trailer fields are skipped.
+ *
+ * @param[in] body, body_len - chunked body, up to and including the last (zero-sized) chunk and the empty line after trailers
+ * @param[out] buf - where to put decoded data. Can be the same as body to decode in place,
+ *                   then body is overwritten (decoded data is never longer than encoded)
+ * @param[in] buf_len - size of buf
+ * @param[out] out_decoded_len - size of decoded data
+ *
+ * @return error code of parsing
+ * @retval PARSING_RES_SUCCEEDED - everything is decoded
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - buf is too small
+ * @retval PARSING_RES_NOT_ENOUGH_DATA - body is correct but doesn't end with the last chunk yet
+ * @retval PARSING_RES_FAILED - body is not correctly chunked
+ */
 http_parsing_result_t http_decode_chunked(const char* body, size_t body_len,
                                           char* buf, size_t buf_len,
                                           size_t* out_decoded_len);
 
+/**
+ * Same as http_decode_chunked, but nothing is copied: every chunk becomes one element of iov
+ * pointing at its data inside body, ready to be passed to writev/sendmsg.
+ *
+ * @param[out] iov - array of elements to fill
+ * @param[in] iov_max - size of iov array
+ * @param[out] out_iov_len - number of elements written to iov
+ * @param[out] out_decoded_len - total size of decoded data
+ *
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - there are more than iov_max chunks
+ */
+http_parsing_result_t http_decode_chunked_iov(const char* body, size_t body_len,
+                                              struct iovec* iov, size_t iov_max,
+                                              size_t* out_iov_len, size_t* out_decoded_len);
+
+/*
+ * Position of a search for all headers with some name, see http_find_all_headers.
+ */
+typedef struct {
+    const http_header_t *headers;
+    size_t headers_len;
+    const http_header_index_t *index;
+
+    const char *name;
+    size_t name_len;
+    http_header_id_t id;
+    uint32_t hash;
+
+    size_t pos;    /* next slot of index, or next header without index */
+    size_t probed; /* slots of index looked at, never more than all of them */
+} http_header_find_iter_t;
+
+/**
+ * Finds the first header of a request with name (case-insensitive). Uses header_index if the request has one.
+ *
+ * @return NULL if there's no such header
+ */
+const http_header_t *http_find_header(const http_request_t *req, const char *name, size_t name_len);
+
+/**
+ * Same as http_find_header for responses.
+ */
+const http_header_t *http_find_response_header(const http_response_t *resp, const char *name, size_t name_len);
+
+/**
+ * Starts a search for all headers of a request with name (case-insensitive), in the order they appear.
+ * name has to stay valid while the iterator is used.
+ */
+void http_find_all_headers(const http_request_t *req, const char *name, size_t name_len, http_header_find_iter_t *out_iter);
+
+/**
+ * Same as http_find_all_headers for responses.
+ */
+void http_find_all_response_headers(const http_response_t *resp, const char *name, size_t name_len, http_header_find_iter_t *out_iter);
+
+/**
+ * Returns the next header found by the search, NULL when there are no more.
+ */
+const http_header_t *http_find_next_header(http_header_find_iter_t *iter);
+
+typedef enum {
+    HTTP_CHUNKED_STAGE_SIZE,          /* hex digits of chunk size */
+    HTTP_CHUNKED_STAGE_SIZE_BWS,      /* whitespace between chunk size and ';' */
+    HTTP_CHUNKED_STAGE_EXT,           /* chunk extensions after ';', skipped */
+    HTTP_CHUNKED_STAGE_SIZE_LF,       /* LF after CR of the size line */
+    HTTP_CHUNKED_STAGE_DATA,          /* chunk data */
+    HTTP_CHUNKED_STAGE_DATA_END,      /* CR or LF after chunk data */
+    HTTP_CHUNKED_STAGE_DATA_LF,       /* LF after CR of chunk data */
+    HTTP_CHUNKED_STAGE_LAST_LINE,     /* CR or LF of the empty line after the last chunk, or a trailer field */
+    HTTP_CHUNKED_STAGE_TRAILER_NAME,  /* name of a trailer field up to ':', skipped */
+    HTTP_CHUNKED_STAGE_TRAILER_VALUE, /* rest of a trailer field, skipped */
+    HTTP_CHUNKED_STAGE_TRAILER_LF,    /* LF after CR of a trailer field */
+    HTTP_CHUNKED_STAGE_LAST_LF,       /* LF after CR of the empty line */
+    HTTP_CHUNKED_STAGE_DONE,
+} http_chunked_stage_t;
+
+/*
+ * Decoder of chunked body that receives it in pieces. It can be cut anywhere,
+ * the decoder remembers where it stopped.
+ */
+typedef struct {
+    http_chunked_stage_t stage;
+
+    uint64_t remaining;  /* chunk size being read, then bytes of chunk data left */
+    size_t size_digits;  /* number of digits of chunk size read so far */
+} http_chunked_decoder_t;
+
+/**
+ * Prepares decoder for a new chunked body.
+ */
+void http_chunked_decoder_init(http_chunked_decoder_t *decoder);
+
+/**
+ * Decodes the next piece of chunked body into buf. Data that is consumed is never needed again,
+ * so a fixed buffer can be reused for every piece.
+ *
+ * @param[in,out] decoder - initialized with http_chunked_decoder_init
+ * @param[in] data, data_len - next piece of chunked body
+ * @param[out] buf - where to put decoded data. Can be the same as data to decode in place
+ * @param[in] buf_len - size of buf
+ * @param[out] out_consumed - number of bytes of data that were consumed
+ * @param[out] out_decoded_len - number of bytes written to buf
+ *
+ * @return error code of parsing
+ * @retval PARSING_RES_SUCCEEDED - the body is over. Data after out_consumed doesn't belong to it
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - buf is full, call again with the data that wasn't consumed
+ * @retval PARSING_RES_NOT_ENOUGH_DATA - all of data is consumed, the body continues in the next piece
+ * @retval PARSING_RES_FAILED - body is not correctly chunked
+ */
+http_parsing_result_t http_chunked_decoder_feed(http_chunked_decoder_t *decoder,
+                                                const char *data, size_t data_len,
+                                                char *buf, size_t buf_len,
+                                                size_t *out_consumed, size_t *out_decoded_len);
+
+/* Size of scratch needed by http_serialize_response */
+#define HTTP_SERIALIZE_SCRATCH_LEN 5
+
+/**
+ * Serializes response into a list of pieces for writev/sendmsg without copying it. Protocol, status text,
+ * headers and body are referenced where they are, only the status code is written to scratch,
+ * separators point to constant strings. Pieces that are next to each other in memory are merged.
+ * Headers are written as they are, Content-Length isn't added.
+ *
+ * @param[in] resp - response to serialize, e.g. one that was parsed. Empty protocol means HTTP/1.1
+ * @param[out] iov - array of elements to fill; resp and scratch have to stay valid while it's used
+ * @param[in] iov_max - size of iov array, 4 + 4 * number of headers + 2 is always enough
+ * @param[out] scratch, scratch_len - buffer of at least HTTP_SERIALIZE_SCRATCH_LEN bytes
+ * @param[out] out_iov_len - number of elements written to iov
+ * @param[out] out_total_len - size of the whole message
+ *
+ * @return error code of serializing
+ * @retval PARSING_RES_SUCCEEDED - everything is written to iov
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - iov or scratch is too small
+ * @retval PARSING_RES_FAILED - status code doesn't have 3 digits
+ */
+http_parsing_result_t http_serialize_response(const http_response_t *resp,
+                                              struct iovec *iov, size_t iov_max,
+                                              char *scratch, size_t scratch_len,
+                                              size_t *out_iov_len, size_t *out_total_len);
+
+/**
+ * Same as http_serialize_response for requests, nothing needs scratch.
+ *
+ * @param[in] iov_max - size of iov array, 6 + 4 * number of headers + 2 is always enough
+ *
+ * @retval PARSING_RES_FAILED - method or target is empty
+ */
+http_parsing_result_t http_serialize_request(const http_request_t *req,
+                                             struct iovec *iov, size_t iov_max,
+                                             size_t *out_iov_len, size_t *out_total_len);
+
+/* Most edits one list can have */
+#define HTTP_REWRITE_MAX_EDITS 64
+
+typedef enum {
+    HTTP_REWRITE_ADD,     /* header is added after all others */
+    HTTP_REWRITE_REMOVE,  /* every header with the name is dropped */
+    HTTP_REWRITE_REPLACE, /* the first header with the name gets the new value, others are dropped; added if there's none */
+} http_rewrite_op_t;
+
+typedef struct {
+    http_rewrite_op_t op;
+
+    const char *name;
+    size_t name_len;
+    http_header_id_t id;
+
+    const char *line; /* "name: value\r\n" in the buffer of the edit list, NULL for HTTP_REWRITE_REMOVE */
+    size_t line_len;
+} http_rewrite_edit_t;
+
+/*
+ * Edit list for forwarding a parsed message with changed headers, e.g. by a proxy.
+ * Only the lines of new headers are written to buf, everything else stays where it was parsed.
+ */
+typedef struct {
+    http_rewrite_edit_t *edits;
+    size_t edits_len;
+    size_t edits_max;
+
+    char *buf;
+    size_t buf_len;
+    size_t buf_used;
+} http_rewrite_t;
+
+/**
+ * Prepares an empty edit list.
+ *
+ * @param[in] edits, edits_max - pre-allocated array for the edits
+ * @param[in] buf, buf_len - buffer for the lines of new headers
+ */
+void http_rewrite_init(http_rewrite_t *rw, http_rewrite_edit_t *edits, size_t edits_max, char *buf, size_t buf_len);
+
+/**
+ * Appends an edit to the list. Names are compared case-insensitively. Edits are applied in the order they are added.
+ *
+ * @param[in] value, value_len - ignored for HTTP_REWRITE_REMOVE
+ *
+ * @return error code of adding the edit
+ * @retval PARSING_RES_SUCCEEDED - the edit is added
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - edits or buf is full, or there are HTTP_REWRITE_MAX_EDITS edits already
+ * @retval PARSING_RES_FAILED - name isn't a token, value is empty (the parser rejects such headers),
+ *                             or value has control characters (which could smuggle in more headers)
+ */
+http_parsing_result_t http_rewrite_add_edit(http_rewrite_t *rw, http_rewrite_op_t op,
+                                            const char *name, size_t name_len,
+                                            const char *value, size_t value_len);
+
+/**
+ * Serializes a parsed request with the edits applied into a list of pieces for writev/sendmsg.
+ * Start line, headers that don't change, the blank line and the body are referenced in the buffer that was parsed,
+ * together with their original line endings, so runs of them are single pieces. If nothing is edited,
+ * the whole message is one piece.
+ *
+ * @param[in] req - request parsed from one buffer, e.g. with http_parse_request; its headers have to point there
+ * @param[out] iov - array of elements to fill; the buffer of req and rw have to stay valid while it's used
+ * @param[in] iov_max - size of iov array, 2 + number of headers + number of edits is always enough
+ * @param[out] out_iov_len - number of elements written to iov
+ * @param[out] out_total_len - size of the whole message
+ *
+ * @retval PARSING_RES_SUCCEEDED - everything is written to iov
+ * @retval PARSING_RES_NOT_ENOUGH_MEMORY - iov is too small
+ */
+http_parsing_result_t http_rewrite_request(const http_rewrite_t *rw, const http_request_t *req,
+                                           struct iovec *iov, size_t iov_max,
+                                           size_t *out_iov_len, size_t *out_total_len);
+
+/**
+ * Same as http_rewrite_request for responses.
+ */
+http_parsing_result_t http_rewrite_response(const http_rewrite_t *rw, const http_response_t *resp,
+                                            struct iovec *iov, size_t iov_max,
+                                            size_t *out_iov_len, size_t *out_total_len);
+
+typedef enum {
+    HTTP_TARGET_ORIGIN,    /* /path?query */
+    HTTP_TARGET_ABSOLUTE,  /* scheme://authority/path?query, to proxies */
+    HTTP_TARGET_AUTHORITY, /* host:port, of CONNECT */
+    HTTP_TARGET_ASTERISK,  /* *, of OPTIONS */
+} http_target_form_t;
+
+/*
+ * Components of a request target (RFC 9112 section 3.2). Missing components are NULL with length 0,
+ * delimiters ("://", "?", "#") aren't included. Nothing is decoded.
+ */
+typedef struct {
+    http_target_form_t form;
+
+    const char *scheme;
+    size_t scheme_len;
+
+    const char *authority;
+    size_t authority_len;
+
+    const char *path; /* "*" for asterisk form */
+    size_t path_len;
+
+    const char *query;
+    size_t query_len;
+
+    const char *fragment; /* not sent by conforming clients, but split off anyway */
+    size_t fragment_len;
+} http_target_t;
+
+/**
+ * Splits request target (target of http_request_t) into components.
+ *
+ * @return error code of parsing
+ * @retval PARSING_RES_SUCCEEDED - target is split
+ * @retval PARSING_RES_FAILED - target is empty or in none of the forms
+ */
+http_parsing_result_t http_parse_target(const char *target, size_t target_len, http_target_t *out_target);
+
+/**
+ * Decodes %XX escapes in place. Decoded data is never longer, so it's written over data.
+ * Parts without escapes are found with the vectorized scanning code and moved at once.
+ *
+ * @param[in,out] data, len - text to decode, e.g. a path or a query value
+ * @param[in] plus_as_space - decode '+' as ' ' too, like in form-encoded query strings
+ * @param[out] out_len - size of decoded data
+ *
+ * @retval PARSING_RES_FAILED - '%' isn't followed by two hex digits. data is partly decoded then
+ */
+http_parsing_result_t http_percent_decode(char *data, size_t len, bool plus_as_space, size_t *out_len);
+
+/*
+ * Position in a query string, see http_query_iter_init.
+ */
+typedef struct {
+    const char *query;
+    size_t query_len;
+    size_t pos;
+} http_query_iter_t;
+
+typedef struct {
+    const char *key;
+    size_t key_len;
+
+    const char *value; /* empty if there's no '=' */
+    size_t value_len;
+} http_query_param_t;
+
+/**
+ * Starts going over key=value pairs of a query string (e.g. query of http_target_t) separated with '&'.
+ * Nothing is allocated or decoded, keys and values point into query.
+ */
+void http_query_iter_init(http_query_iter_t *iter, const char *query, size_t query_len);
+
+/**
+ * Returns the next pair in out_param, false when there are no more. Empty pairs are skipped.
+ */
+bool http_query_next(http_query_iter_t *iter, http_query_param_t *out_param);
+
+/**
+ * Parses a Content-Length value, e.g. value of a HTTP_HEADER_CONTENT_LENGTH header.
+ *
+ * @retval PARSING_RES_FAILED - value is empty, has something other than digits, or doesn't fit into 64 bits
+ */
+http_parsing_result_t http_parse_content_length(const char *value, size_t value_len, uint64_t *out_length);
+
+/*
+ * Statistics of parsing calls made by a thread. They are only collected when the library is built
+ * with HTTP_PARSER_STATS defined (CMake option HTTP_PARSER_STATS), otherwise the parser has no code for them.
+ *
+ * Counters are per thread, so updating them needs no atomics. Every thread can take a snapshot of its own
+ * counters with http_parser_stats_get, snapshots of several threads are summed with http_parser_stats_add.
+ */
+
+typedef enum {
+    HTTP_PARSER_FAILURE_START_LINE,
+    HTTP_PARSER_FAILURE_HEADER,
+    HTTP_PARSER_FAILURE_FRAMING, /* Content-Length or Transfer-Encoding of framed parsing */
+    HTTP_PARSER_FAILURE_CHUNKED, /* chunked body given to http_decode_chunked(_iov) */
+    HTTP_PARSER_FAILURE_COUNT,
+} http_parser_failure_t;
+
+/*
+ * Histogram buckets are powers of two. Bucket 0 has values below the first limit, bucket i below
+ * twice the limit of bucket i - 1, and the last one has all values above.
+ */
+#define HTTP_PARSER_STATS_BUCKETS 8
+#define HTTP_PARSER_STATS_HEADER_COUNT_FIRST_LIMIT 4
+#define HTTP_PARSER_STATS_HEADER_SIZE_FIRST_LIMIT 256
+
+typedef struct {
+    uint64_t bytes_scanned;     /* text given to parsing calls, again for every call on a partial message */
+    uint64_t messages;          /* requests and responses parsed completely */
+    uint64_t chunked_bodies;    /* chunked bodies decoded completely */
+    uint64_t not_enough_data;   /* calls that returned PARSING_RES_NOT_ENOUGH_DATA */
+    uint64_t not_enough_memory; /* calls that returned PARSING_RES_NOT_ENOUGH_MEMORY */
+    uint64_t stopped;           /* calls stopped by a callback */
+    uint64_t failures[HTTP_PARSER_FAILURE_COUNT];
+
+    /* Of complete messages */
+    uint64_t header_count[HTTP_PARSER_STATS_BUCKETS];
+    uint64_t header_size[HTTP_PARSER_STATS_BUCKETS]; /* start line and headers, in bytes */
+} http_parser_stats_t;
+
+/**
+ * Copies counters of the calling thread to out_stats.
+ *
+ * @return false if statistics aren't compiled in, out_stats is all zeros then
+ */
+bool http_parser_stats_get(http_parser_stats_t *out_stats);
+
+/**
+ * Sets counters of the calling thread to zero.
+ */
+void http_parser_stats_reset(void);
+
+/**
+ * Adds every counter of stats to total.
+ */
+void http_parser_stats_add(http_parser_stats_t *total, const http_parser_stats_t *stats);
+
+/*
+ * Request with only its request line parsed. Headers are left as one block of text, split into
+ * headers only when they are asked for with http_header_iter_t.
+ */
+typedef struct {
+    const char *method;
+    size_t method_len;
+
+    const char *target;
+    size_t target_len;
+
+    const char *protocol;
+    size_t protocol_len;
+
+    const char *header_block; /* header lines with their line endings, without the blank line */
+    size_t header_block_len;
+
+    const char *body; /* everything after the blank line */
+    size_t body_len;
+} http_lazy_request_t;
+
+/**
+ * Parses the request line, and finds where headers end with one vectorized search for an empty line.
+ * Headers aren't checked, they fail when iterated if they are invalid.
+ *
+ * @retval PARSING_RES_NOT_ENOUGH_DATA - the request line or header block isn't complete
+ * @retval PARSING_RES_FAILED - the request line isn't valid
+ */
+http_parsing_result_t http_parse_request_lazy(const char *text, size_t text_len, http_lazy_request_t *out_req);
+
+/*
+ * Position in a header block, see http_header_iter_init.
+ */
+typedef struct {
+    const char *block;
+    size_t block_len;
+    size_t pos;
+} http_header_iter_t;
+
+/**
+ * Starts splitting a header block (e.g. of http_lazy_request_t) into headers.
+ */
+void http_header_iter_init(http_header_iter_t *iter, const char *header_block, size_t header_block_len);
+
+/**
+ * Splits the next header line into out_header, with the same checks as http_parse_request.
+ *
+ * @retval PARSING_RES_SUCCEEDED - out_header is the next header
+ * @retval PARSING_RES_NOT_ENOUGH_DATA - there are no more headers
+ * @retval PARSING_RES_FAILED - the line isn't a valid header, iteration ends
+ */
+http_parsing_result_t http_header_iter_next(http_header_iter_t *iter, http_header_t *out_header);
+
 #endif /* LIB_HTTP_PARSER_H */
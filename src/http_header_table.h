@@ -0,0 +1,151 @@
+/* Generated by tools/gen_header_ids.py, don't edit. */
+
+#ifndef LIB_HTTP_HEADER_TABLE_H
+#define LIB_HTTP_HEADER_TABLE_H
+
+#include "http_parser.h"
+
+#define HEADER_HASH(len, first, middle, next_to_last) \
+    (((len) * 135u + (first) * 231u + (middle) * 140u + (next_to_last) * 176u) & 511u)
+
+#define HEADER_NAME_MIN_LEN 2
+#define HEADER_NAME_MAX_LEN 35
+
+static const struct {
+    const char *name;
+    size_t name_len;
+} header_names[HTTP_HEADER_COUNT] = {
+    {"", 0},
+    {"A-IM", 4},
+    {"Accept", 6},
+    {"Accept-Charset", 14},
+    {"Accept-Encoding", 15},
+    {"Accept-Language", 15},
+    {"Accept-Patch", 12},
+    {"Accept-Post", 11},
+    {"Accept-Ranges", 13},
+    {"Access-Control-Allow-Credentials", 32},
+    {"Access-Control-Allow-Headers", 28},
+    {"Access-Control-Allow-Methods", 28},
+    {"Access-Control-Allow-Origin", 27},
+    {"Access-Control-Expose-Headers", 29},
+    {"Access-Control-Max-Age", 22},
+    {"Access-Control-Request-Headers", 30},
+    {"Access-Control-Request-Method", 29},
+    {"Age", 3},
+    {"Allow", 5},
+    {"Alt-Svc", 7},
+    {"Authorization", 13},
+    {"Cache-Control", 13},
+    {"Clear-Site-Data", 15},
+    {"Connection", 10},
+    {"Content-Digest", 14},
+    {"Content-Disposition", 19},
+    {"Content-Encoding", 16},
+    {"Content-Language", 16},
+    {"Content-Length", 14},
+    {"Content-Location", 16},
+    {"Content-Range", 13},
+    {"Content-Security-Policy", 23},
+    {"Content-Security-Policy-Report-Only", 35},
+    {"Content-Type", 12},
+    {"Cookie", 6},
+    {"Cross-Origin-Embedder-Policy", 28},
+    {"Cross-Origin-Opener-Policy", 26},
+    {"Cross-Origin-Resource-Policy", 28},
+    {"Date", 4},
+    {"Early-Data", 10},
+    {"ETag", 4},
+    {"Expect", 6},
+    {"Expires", 7},
+    {"Forwarded", 9},
+    {"From", 4},
+    {"Host", 4},
+    {"If-Match", 8},
+    {"If-Modified-Since", 17},
+    {"If-None-Match", 13},
+    {"If-Range", 8},
+    {"If-Unmodified-Since", 19},
+    {"Keep-Alive", 10},
+    {"Last-Modified", 13},
+    {"Link", 4},
+    {"Location", 8},
+    {"Max-Forwards", 12},
+    {"Origin", 6},
+    {"Pragma", 6},
+    {"Prefer", 6},
+    {"Preference-Applied", 18},
+    {"Priority", 8},
+    {"Proxy-Authenticate", 18},
+    {"Proxy-Authorization", 19},
+    {"Range", 5},
+    {"Referer", 7},
+    {"Referrer-Policy", 15},
+    {"Refresh", 7},
+    {"Retry-After", 11},
+    {"Sec-Fetch-Dest", 14},
+    {"Sec-Fetch-Mode", 14},
+    {"Sec-Fetch-Site", 14},
+    {"Sec-Fetch-User", 14},
+    {"Sec-Purpose", 11},
+    {"Sec-WebSocket-Accept", 20},
+    {"Sec-WebSocket-Extensions", 24},
+    {"Sec-WebSocket-Key", 17},
+    {"Sec-WebSocket-Protocol", 22},
+    {"Sec-WebSocket-Version", 21},
+    {"Server", 6},
+    {"Server-Timing", 13},
+    {"Set-Cookie", 10},
+    {"Strict-Transport-Security", 25},
+    {"TE", 2},
+    {"Timing-Allow-Origin", 19},
+    {"Trailer", 7},
+    {"Transfer-Encoding", 17},
+    {"Upgrade", 7},
+    {"Upgrade-Insecure-Requests", 25},
+    {"User-Agent", 10},
+    {"Vary", 4},
+    {"Via", 3},
+    {"WWW-Authenticate", 16},
+    {"Want-Content-Digest", 19},
+    {"X-Content-Type-Options", 22},
+    {"X-Frame-Options", 15},
+};
+
+/* Slot of HEADER_HASH -> id */
+static const uint8_t header_hash_table[512] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  69,   0,   0,   0,   0,
+      0,  15,   0,  46,   0,   0,   0,   0,   0,  33,   0,   0,   0,   0,  20,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     17,   0,   0,   0,   0,  62,   0,   0,   0,  14,   0,   0,   4,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  68,  86,   0,   0,   0,
+      0,   0,   0,  24,   0,   0,   0,   0,   0,   0,  22,   0,   0,  94,   8,   0,
+     30,   0,   0,  52,   0,   0,   0,   0,   0,  63,   0,   0,   0,   3,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   6,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  50,   0,  72,   0,
+      0,  26,   0,   0,  21,   0,  87,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,  82,  67,   0,   0,   0,  71,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,  39,   0,   0,   0,   0,   0,   0,   0,  91,   0,   0,
+      0,   0,   0,  49,   0,   0,   0,   0,   0,   0,   0,   0,  79,   0,   0,   0,
+     75,   0,   0,   0,   0,   0,  48,  78,   0,   0,   0,  76,   0,   2,   0,   0,
+      0,   0,   0,   0,  19,   0,   0,   0,   0,   0,   0,  40,   0,   0,   0,   0,
+      0,   0,   0,   0,  12,   0,   0,   0,   0,   0,   0,  70,   0,   0,   0,  23,
+      0,   0,   0,  28,   0,   0,  25,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,  29,   0,   0,   0,   0,  44,   0,   0,   0,  61,  65,
+      0,   0,  47,  34,   0,   0,   0,   0,   0,  84,  59,  64,   0,   0,   0,   1,
+      0,   0,   0,   0,   0,  43,   0,  10,   0,   0,  32,   0,   0,   0,  89,   0,
+      5,   0,   0,   0,   0,   0,   0,   0,  53,   0,   0,   0,   0,   0,   0,   0,
+     60,   0,   0,   0,   0,  37,   0,   0,   0,   0,   0,   0,  54,   0,   0,   0,
+      0,   0,  58,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  74,  57,   0,
+      0,   0,  31,   0,   0,  88,   0,   0,  38,   0,  18,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,  41,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,  27,   0,  11,   0,   0,   0,  90,  77,   0,  93,   0,
+     42,   0,  92,   0,   0,   0,   0,   9,   0,   0,   0,   0,   0,   0,  16,   0,
+      0,   0,   0,   0,   0,  35,   0,  55,   0,   0,   0,   0,   0,   0,  13,  36,
+      0,   0,   0,   0,   7,  73,   0,  56,   0,   0,   0,   0,   0,   0,   0,  85,
+      0,   0,   0,   0,   0,   0,   0,   0,  45,   0,   0,   0,   0,   0,   0,  80,
+      0,  83,   0,   0,  81,   0,   0,  66,   0,   0,   0,   0,   0,   0,   0,  51,
+};
+
+#endif /* LIB_HTTP_HEADER_TABLE_H */
@@ -1,5 +1,9 @@
 #include "http_parser.h"
+#include "http_scan.h"
+#include "http_header_table.h"
+#include "http_probes.h"
 #include <assert.h>
+#include <string.h>
 
 #define STR_FMT "%.*s"
 #define STR_ARG(str) str.count, str.data
@@ -10,31 +14,64 @@ typedef struct {
     size_t count;
 } string;
 
-// Only LF
-// TODO: handle CRLF and CR
-static string eat_line(string* str) {
-    string result = {str->data, 0};
-    while (str->count > 0 && *str->data != '\n') {
-        str->data++;
-        str->count--;
-        result.count++;
-    }
+static bool is_whitespace(char ch) {
+    return http_char_is(ch, HTTP_CHAR_WHITESPACE); // Should '\r' be here?
+}
 
-    // Skip newline character.
-    if (str->count > 0) {
-        str->data++;
-        str->count--;
-    }
+static bool is_numeric(char ch) {
+    return http_char_is(ch, HTTP_CHAR_DIGIT);
+}
+
+static size_t index_of_char(string str, char ch) {
+    return http_scan->index_of_char(str.data, str.count, ch);
+}
+
+static size_t index_of_whitespace_class(string str, bool want_whitespace) {
+    return http_scan->index_of_whitespace_class(str.data, str.count, want_whitespace);
+}
+
+static size_t index_of_either_char(string str, char a, char b) {
+    return http_scan->index_of_either_char(str.data, str.count, a, b);
+}
+
+static size_t index_of_non_token(string str) {
+    return http_scan->index_of_non_token(str.data, str.count);
+}
+
+static size_t index_of_control(string str) {
+    return http_scan->index_of_control(str.data, str.count);
+}
 
+static string eat_until(string* str, size_t index) {
+    string result = {str->data, index};
+    str->data  += index;
+    str->count -= index;
     return result;
 }
 
+// LF or CRLF. Only takes a line whose LF has arrived, a CR at the end of data may still be followed by it
+static bool eat_complete_line(string* str, string* out_line) {
+    size_t index = index_of_char(*str, '\n');
+    if (index == str->count) {
+        return false;
+    }
+
+    string line = eat_until(str, index);
+    str->data++;
+    str->count--;
+
+    if (line.count > 0 && line.data[line.count - 1] == '\r') {
+        line.count--;
+    }
+    *out_line = line;
+    return true;
+}
+
+// Stops at the first character that isn't a token, which has to be ':' for a valid name
 static string eat_header_name(string* str) {
-    string result = {str->data, 0};
-    while (str->count > 0 && *str->data != ':') {
-        str->data++;
-        str->count--;
-        result.count++;
+    string result = eat_until(str, index_of_non_token(*str));
+    if (str->count > 0 && str->data[0] != ':') {
+        return (string) {0};
     }
 
     // Skip colon.
@@ -46,70 +83,144 @@ static string eat_header_name(string* str) {
     return result;
 }
 
-static bool is_whitespace(char ch) {
-    return ch == ' ' || ch == '\t' || ch == '\n'; // Should '\r' be here?
+static string eat_word(string* str) {
+    return eat_until(str, index_of_whitespace_class(*str, true));
 }
 
-static bool is_numeric(char ch) {
-    return ch >= '0' && ch <= '9';
+static void eat_whitespace(string* str) {
+    eat_until(str, index_of_whitespace_class(*str, false));
+}
+
+// Integers are parsed 8 characters at a time (SWAR): the characters are loaded into one uint64_t,
+// every byte is validated at once and the digits are combined in 3 steps instead of a multiply per digit.
+
+#define SWAR_ONES  0x0101010101010101ull
+#define SWAR_HIGHS 0x8080808080808080ull
+
+// Loads at most 8 characters as a big-endian number, so the last character is in the lowest byte.
+// Missing characters in front are '0', which doesn't change the value.
+static uint64_t load_digits(const char* data, size_t count) {
+    assert(count <= 8);
+
+    unsigned char bytes[8];
+    memset(bytes, '0', 8 - count);
+    memcpy(bytes + 8 - count, data, count);
+
+    uint64_t v = 0;
+    for (size_t i = 0; i < 8; i++) {
+        v = v << 8 | bytes[i];
+    }
+    return v;
 }
 
-static bool is_hexadecimal(char ch) {
-    return is_numeric(ch) || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+// High bit of every byte of v that is in [lo, hi]. Bytes of v must be below 0x80, then adding
+// to a byte can't carry into the next one.
+static uint64_t swar_in_range(uint64_t v, unsigned char lo, unsigned char hi) {
+    uint64_t at_least_lo = v + SWAR_ONES * (0x80 - lo);
+    uint64_t above_hi    = v + SWAR_ONES * (0x80 - hi - 1);
+    return at_least_lo & ~above_hi & SWAR_HIGHS;
 }
 
-static string eat_word(string* str) {
-    string result = {str->data, 0};
-    while (str->count > 0 && !is_whitespace(*str->data)) {
-        str->data++;
-        str->count--;
-        result.count++;
+// 8 decimal digits from load_digits, false if any isn't a digit
+static bool parse_eight_digits(uint64_t v, uint32_t* out) {
+    if ((v & SWAR_HIGHS) != 0 || swar_in_range(v, '0', '9') != SWAR_HIGHS) {
+        return false;
     }
-    return result;
+
+    v &= SWAR_ONES * 0x0F;
+    v = (v & 0x00FF00FF00FF00FFull) + ((v >> 8) & 0x00FF00FF00FF00FFull) * 10;
+    v = (v & 0x0000FFFF0000FFFFull) + ((v >> 16) & 0x0000FFFF0000FFFFull) * 100;
+    v = (v & 0x00000000FFFFFFFFull) + (v >> 32) * 10000;
+    *out = (uint32_t) v;
+    return true;
 }
 
-static void eat_whitespace(string* str) {
-    while (str->count > 0 && is_whitespace(*str->data)) {
-        str->data++;
-        str->count--;
+// 8 hex digits from load_digits, false if any isn't a hex digit
+static bool parse_eight_hex_digits(uint64_t v, uint32_t* out) {
+    if ((v & SWAR_HIGHS) != 0) {
+        return false;
+    }
+    uint64_t valid = swar_in_range(v, '0', '9') | swar_in_range(v, 'A', 'F') | swar_in_range(v, 'a', 'f');
+    if (valid != SWAR_HIGHS) {
+        return false;
     }
+
+    // Letters have 0x40 set, 'A' and 'a' are 1 in the low bits, so they need 9 more
+    v = (v & (SWAR_ONES * 0x0F)) + ((v >> 6) & SWAR_ONES) * 9;
+    v = (v | (v >> 4)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v >> 8)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+    *out = (uint32_t) v;
+    return true;
 }
 
 static uint16_t string_to_u16(string str, bool* done) {
-    uint16_t result = 0;
-    for (size_t i = 0; i < str.count; i++) {
-        if (!is_numeric(str.data[i])) {
+    uint32_t result;
+    if (str.count == 0 || str.count > 8 || !parse_eight_digits(load_digits(str.data, str.count), &result) ||
+        result > UINT16_MAX) {
+        *done = false;
+        return 0;
+    }
+
+    *done = true;
+    return (uint16_t) result;
+}
+
+static uint64_t string_to_u64(string str, bool* done) {
+    if (str.count == 0) {
+        *done = false;
+        return 0;
+    }
+
+    // First block takes the digits that don't fill 8, so the rest are whole
+    size_t block_len = str.count % 8 == 0 ? 8 : str.count % 8;
+    uint64_t result = 0;
+    for (size_t i = 0; i < str.count; i += block_len, block_len = 8) {
+        uint32_t block;
+        if (!parse_eight_digits(load_digits(str.data + i, block_len), &block)) {
             *done = false;
             return 0;
         }
 
-        result *= 10;
-        result += str.data[i] - '0';
+        if (result > (UINT64_MAX - block) / 100000000) {
+            // Overflow
+            *done = false;
+            return 0;
+        }
+        result = result * 100000000 + block;
     }
 
     *done = true;
     return result;
 }
 
-static uint32_t hex_to_u32(string str, bool* done) {
-    uint32_t result = 0;
-    for (size_t i = 0; i < str.count; i++) {
-        if (!is_hexadecimal(str.data[i])) {
-            *done = false;
-            return 0;
+// 
+// Appends the hex digits of str to *value, 8 at a time. Every chunked decoder goes through this, so they
+// accept the same sizes: any number of leading zeros, then whatever fits in 64 bits.
+// Returns false if a character isn't a hex digit or the value overflows.
+// 
+static bool append_hex_digits(uint64_t* value, string str) {
+    for (size_t i = 0; i < str.count; i += 8) {
+        size_t block_len = str.count - i < 8 ? str.count - i : 8;
+
+        uint32_t block;
+        if (!parse_eight_hex_digits(load_digits(str.data + i, block_len), &block)) {
+            return false;
         }
-
-        result *= 16;
-        
-        if (is_numeric(str.data[i])) {
-            result += str.data[i] - '0';
-        } else if (str.data[i] >= 'a' && str.data[i] <= 'f') {
-            result += str.data[i] - 'a';
-        } else if (str.data[i] >= 'A' && str.data[i] <= 'F') {
-            result += str.data[i] - 'A';
-        } else {
-            assert(false);
+        if (*value > UINT64_MAX >> (4 * block_len)) {
+            // Overflow
+            return false;
         }
+        *value = *value << (4 * block_len) | block;
+    }
+    return true;
+}
+
+static uint64_t hex_to_u64(string str, bool* done) {
+    uint64_t result = 0;
+    if (str.count == 0 || !append_hex_digits(&result, str)) {
+        *done = false;
+        return 0;
     }
 
     *done = true;
@@ -128,13 +239,24 @@ static bool strings_match(string a, string b) {
     return true;
 }
 
-static bool string_contains_char(string str, char ch) {
-    for (size_t i = 0; i < str.count; i++) {
-        if (str.data[i] == ch) {
-            return true;
+static char to_lower(char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? (char) (ch - 'A' + 'a') : ch;
+}
+
+static bool strings_match_ignore_case(string a, string b) {
+    if (a.count != b.count) {
+        return false;
+    }
+    for (size_t i = 0; i < a.count; i++) {
+        if (to_lower(a.data[i]) != to_lower(b.data[i])) {
+            return false;
         }
     }
-    return false;
+    return true;
+}
+
+static bool string_contains_char(string str, char ch) {
+    return index_of_char(str, ch) < str.count;
 }
 
 static bool starts_with(string str, string prefix) {
@@ -170,294 +292,279 @@ static http_parsing_result_t parse_protocol_version(string* status_line, string*
     return PARSING_RES_SUCCEEDED;
 }
 
-static http_parsing_result_t parse_headers(string* text,
-                                           http_header_t* headers_buf, size_t headers_max_len,
-                                           size_t* out_num_headers_written) {
-    if (text->count == 0) {
+static http_parsing_result_t parse_request_line(string line, http_request_t* out_req) {
+    // Method.
+    eat_whitespace(&line);
+    string method = eat_word(&line);
+
+    if (method.count == 0) {
         return PARSING_RES_NOT_ENOUGH_DATA;
     }
 
-    size_t header_index = 0;
-    size_t num_headers_written = 0;
-
-    while (text->count > 0) {
-        string header_line = eat_line(text);
-
-        if (header_line.count == 0) {
-            // Encountered a blank line
-            *out_num_headers_written = num_headers_written;
-            return PARSING_RES_SUCCEEDED;
-        }
+    out_req->method     = method.data;
+    out_req->method_len = method.count;
 
-        eat_whitespace(&header_line);
+    // Target.
+    eat_whitespace(&line);
+    string target = eat_word(&line);
 
-        if (!string_contains_char(header_line, ':')) {
-            return PARSING_RES_NOT_ENOUGH_DATA;
-        }
+    if (target.count == 0) {
+        return PARSING_RES_NOT_ENOUGH_DATA;
+    }
 
-        string header_name = eat_header_name(&header_line);
+    out_req->target     = target.data;
+    out_req->target_len = target.count;
 
-        if (header_name.count == 0) {
-            return PARSING_RES_NOT_ENOUGH_DATA;
-        }
+    // Protocol version.
+    string protocol_version;
+    http_parsing_result_t res = parse_protocol_version(&line, &protocol_version);
+    if (res != PARSING_RES_SUCCEEDED) {
+        return res;
+    }
 
-        eat_whitespace(&header_line);
-        string header_value = header_line;
+    out_req->protocol     = protocol_version.data;
+    out_req->protocol_len = protocol_version.count;
 
-        if (header_value.count == 0) {
-            return PARSING_RES_NOT_ENOUGH_DATA;
-        }
+    return PARSING_RES_SUCCEEDED;
+}
 
-        if (header_index < headers_max_len) {
-            headers_buf[header_index].name     = header_name.data;
-            headers_buf[header_index].name_len = header_name.count;
+static http_parsing_result_t parse_status_line(string line, http_response_t* out_resp) {
+    // Protocol version.
+    string protocol_version;
+    http_parsing_result_t res = parse_protocol_version(&line, &protocol_version);
+    if (res != PARSING_RES_SUCCEEDED) {
+        return res;
+    }
 
-            headers_buf[header_index].value     = header_value.data;
-            headers_buf[header_index].value_len = header_value.count;
+    out_resp->protocol     = protocol_version.data;
+    out_resp->protocol_len = protocol_version.count;
 
-            num_headers_written++;
-        } else {
-            // Ran out of memory.
-            return PARSING_RES_NOT_ENOUGH_MEMORY;
-        }
+    // Status code.
+    eat_whitespace(&line);
+    string status_code = eat_word(&line);
 
-        header_index++;
+    if (status_code.count == 0) {
+        return PARSING_RES_NOT_ENOUGH_DATA;
     }
 
-    // Didn't encounter a blank line
-    return PARSING_RES_NOT_ENOUGH_DATA;
-}
-
-http_parsing_result_t http_parse_response(const char *text_data, size_t text_len,
-                                          http_header_t *headers_buf, size_t headers_max_len,
-                                          http_response_t *out_resp) {
-    assert(text_data);
-    assert(headers_buf);
-    assert(out_resp);
-
-    *out_resp = (http_response_t) {0};
-    
-    string text = {text_data, text_len};
+    bool done;
+    out_resp->status_code = string_to_u16(status_code, &done);
+    if (!done) {
+        return PARSING_RES_FAILED;
+    }
 
-    // Read status line.
-    {
-        string status_line = eat_line(&text);
+    // Remaining line is the status text.
+    eat_whitespace(&line);
+    string status_text = line;
 
-        // Protocol version.
-        string protocol_version;
-        http_parsing_result_t res = parse_protocol_version(&status_line, &protocol_version);
-        if (res != PARSING_RES_SUCCEEDED) {
-            if (res == PARSING_RES_NOT_ENOUGH_DATA) {
-                if (text.count > 0) {
-                    // 
-                    // If data is incomplete at this point and there's more data then it's an error
-                    // (leftover data in same line should've been handled in parse_protocol_version)
-                    // 
-                    return PARSING_RES_FAILED;
-                }
-            }
-            return res;
-        }
+    // Maybe status text can be empty, so don't error
 
-        out_resp->protocol     = protocol_version.data;
-        out_resp->protocol_len = protocol_version.count;
+    out_resp->status_text     = status_text.data;
+    out_resp->status_text_len = status_text.count;
 
-        // Status code.
-        eat_whitespace(&status_line);
-        string status_code = eat_word(&status_line);
+    return PARSING_RES_SUCCEEDED;
+}
 
-        if (status_code.count == 0) {
-            return PARSING_RES_NOT_ENOUGH_DATA;
-        }
+// 
+// Perfect hash over the well-known names picks the only candidate, which is then compared.
+// Only the length and three bytes of the name are hashed.
+// 
+static http_header_id_t header_id(string name) {
+    if (name.count < HEADER_NAME_MIN_LEN || name.count > HEADER_NAME_MAX_LEN) {
+        return HTTP_HEADER_UNKNOWN;
+    }
 
-        bool done;
-        out_resp->status_code = string_to_u16(status_code, &done);
-        if (!done) {
-            return PARSING_RES_FAILED;
-        }
+    const unsigned char* bytes = (const unsigned char*) name.data;
+    unsigned slot = HEADER_HASH((unsigned) name.count,
+                                bytes[0] | 0x20u,
+                                bytes[name.count / 2] | 0x20u,
+                                bytes[name.count - 2] | 0x20u);
 
-        // Remaining line is the status text.
-        eat_whitespace(&status_line);
-        string status_text = status_line;
+    http_header_id_t id = (http_header_id_t) header_hash_table[slot];
+    if (id == HTTP_HEADER_UNKNOWN) {
+        return HTTP_HEADER_UNKNOWN;
+    }
 
-        // Maybe status text can be empty, so don't error
+    string candidate = {header_names[id].name, header_names[id].name_len};
+    if (!strings_match_ignore_case(name, candidate)) {
+        return HTTP_HEADER_UNKNOWN;
+    }
+    return id;
+}
 
-        out_resp->status_text     = status_text.data;
-        out_resp->status_text_len = status_text.count;
+// 
+// Hash of well-known names is their id, so only unknown names have to be hashed byte by byte
+// (FNV-1a of lower case). Low bits pick the slot, high 16 bits are kept in it.
+// 
+static uint32_t header_name_hash(string name, http_header_id_t id) {
+    if (id != HTTP_HEADER_UNKNOWN) {
+        return (uint32_t) id * 0x9E3779B1u;
     }
 
-    // Read headers.
-    {
-        size_t num_headers_written;
-        http_parsing_result_t res = parse_headers(&text, headers_buf, headers_max_len, &num_headers_written);
-        if (res != PARSING_RES_SUCCEEDED) {
-            if (res == PARSING_RES_NOT_ENOUGH_DATA) {
-                if (text.count > 0) {
-                    // Same situation like when parsing protocol version
-                    return PARSING_RES_FAILED;
-                }
-            }
-            return res;
-        }
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < name.count; i++) {
+        hash ^= (uint8_t) to_lower(name.data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-        out_resp->headers     = headers_buf;
-        out_resp->headers_len = num_headers_written;
+static bool header_has_name(const http_header_t* header, string name, http_header_id_t id) {
+    if (id != HTTP_HEADER_UNKNOWN) {
+        return header->id == id;
     }
+    return header->id == HTTP_HEADER_UNKNOWN &&
+           strings_match_ignore_case((string) {header->name, header->name_len}, name);
+}
 
-    // Remaining text is the body.
-    {
-        string body = text;
+static void header_index_clear(http_header_index_t* index) {
+    memset(index->slots, 0, index->slots_len * sizeof(index->slots[0]));
+    index->count = 0;
+    index->overflowed = false;
+}
 
-        // Body is optional, so don't check for empty
+static void header_index_insert(http_header_index_t* index, size_t header_index, uint32_t hash) {
+    // Keep at least a quarter of slots empty, so probing stays short, and at least one, so probing ends
+    size_t empty_min = index->slots_len / 4 > 0 ? index->slots_len / 4 : 1;
+    if (index->overflowed || header_index >= 0xFFFF || index->count >= index->slots_len - empty_min) {
+        index->overflowed = true;
+        return;
+    }
 
-        out_resp->body     = body.data;
-        out_resp->body_len = body.count;
+    size_t mask = index->slots_len - 1;
+    size_t pos = hash & mask;
+    while (index->slots[pos] != 0) {
+        pos = (pos + 1) & mask;
     }
 
-    return PARSING_RES_SUCCEEDED;
+    index->slots[pos] = (hash & 0xFFFF0000u) | (uint32_t) (header_index + 1);
+    index->count++;
 }
 
-http_parsing_result_t http_parse_request(const char *text_data, size_t text_len,
-                                         http_header_t *headers_buf, size_t headers_max_len,
-                                         http_request_t *out_req) {
-    assert(text_data);
-    assert(headers_buf);
-    assert(out_req);
+static http_parsing_result_t parse_header_line(string line, string* out_name, string* out_value) {
+    eat_whitespace(&line);
 
-    *out_req = (http_request_t) {0};
-    
-    string text = {text_data, text_len};
+    string header_name = eat_header_name(&line);
 
-    // Read status line.
-    {
-        string status_line = eat_line(&text);
+    if (header_name.count == 0) {
+        // Not a token before ':', e.g. whitespace
+        return line.count > 0 ? PARSING_RES_FAILED : PARSING_RES_NOT_ENOUGH_DATA;
+    }
 
-        // Method.
-        eat_whitespace(&status_line);
-        string method = eat_word(&status_line);
-        
-        if (method.count == 0) {
-            return PARSING_RES_NOT_ENOUGH_DATA;
-        }
+    eat_whitespace(&line);
+    string header_value = line;
 
-        out_req->method     = method.data;
-        out_req->method_len = method.count;
+    if (header_value.count == 0) {
+        return PARSING_RES_NOT_ENOUGH_DATA;
+    }
 
-        // Target.
-        eat_whitespace(&status_line);
-        string target = eat_word(&status_line);
-        
-        if (target.count == 0) {
-            return PARSING_RES_NOT_ENOUGH_DATA;
-        }
+    *out_name  = header_name;
+    *out_value = header_value;
+    return PARSING_RES_SUCCEEDED;
+}
+
+// 
+// Where decoded chunks go: copied to buf, or referenced by iov.
+// With neither of them, nothing is output, only the end of the body is found.
+// 
+typedef struct {
+    char* buf;
+    size_t buf_len;
 
-        out_req->target     = target.data;
-        out_req->target_len = target.count;
+    struct iovec* iov;
+    size_t iov_max;
+    size_t iov_len;
 
-        // Protocol version.
-        string protocol_version;
-        http_parsing_result_t res = parse_protocol_version(&status_line, &protocol_version);
-        if (res != PARSING_RES_SUCCEEDED) {
-            if (res == PARSING_RES_NOT_ENOUGH_DATA) {
-                if (text.count > 0) {
-                    // 
-                    // If data is incomplete at this point and there's more data then it's an error
-                    // (leftover data in same line should've been handled in parse_protocol_version)
-                    // 
-                    return PARSING_RES_FAILED;
-                }
-            }
-            return res;
-        }
+    size_t decoded_len;
+} chunked_output_t;
 
-        out_req->protocol     = protocol_version.data;
-        out_req->protocol_len = protocol_version.count;
-    }
+static http_parsing_result_t output_chunk(chunked_output_t* out, string chunk) {
+    if (out->buf) {
+        if (out->buf_len - out->decoded_len < chunk.count) {
+            return PARSING_RES_NOT_ENOUGH_MEMORY;
+        }
 
-    // Read headers.
-    {
-        size_t num_headers_written;
-        http_parsing_result_t res = parse_headers(&text, headers_buf, headers_max_len, &num_headers_written);
-        if (res != PARSING_RES_SUCCEEDED) {
-            if (res == PARSING_RES_NOT_ENOUGH_DATA) {
-                if (text.count > 0) {
-                    // Same situation like when parsing protocol version
-                    return PARSING_RES_FAILED;
-                }
-            }
-            return res;
+        // Decoding in place moves every chunk back over the size lines before it, so the ranges can overlap
+        memmove(out->buf + out->decoded_len, chunk.data, chunk.count);
+    } else if (out->iov) {
+        if (out->iov_len >= out->iov_max) {
+            return PARSING_RES_NOT_ENOUGH_MEMORY;
         }
 
-        out_req->headers     = headers_buf;
-        out_req->headers_len = num_headers_written;
+        out->iov[out->iov_len].iov_base = (void*) chunk.data;
+        out->iov[out->iov_len].iov_len  = chunk.count;
+        out->iov_len++;
     }
 
-    // Remaining text is the body.
-    {
-        string body = text;
+    out->decoded_len += chunk.count;
+    return PARSING_RES_SUCCEEDED;
+}
 
-        // Body is optional, so don't check for empty
+static bool is_blank(char ch) {
+    return ch == ' ' || ch == '\t';
+}
 
-        out_req->body     = body.data;
-        out_req->body_len = body.count;
+// Chunk size, optionally followed by extensions (RFC 9112 section 7.1.1), which are ignored
+static http_parsing_result_t parse_chunk_size_line(string line, uint64_t* out_length) {
+    string length_str = eat_until(&line, index_of_char(line, ';'));
+    if (line.count > 0) {
+        // Whitespace is allowed before the extensions
+        while (length_str.count > 0 && is_blank(length_str.data[length_str.count - 1])) {
+            length_str.count--;
+        }
+        if (index_of_control(line) != line.count) {
+            return PARSING_RES_FAILED;
+        }
     }
 
-    return PARSING_RES_SUCCEEDED;
+    bool done;
+    *out_length = hex_to_u64(length_str, &done);
+    return done ? PARSING_RES_SUCCEEDED : PARSING_RES_FAILED;
 }
 
-http_parsing_result_t http_decode_chunked(const char* body_data, size_t body_len,
-                                          char* buf, size_t buf_len,
-                                          size_t* out_decoded_len) {
-    assert(body_data);
-    assert(buf);
-    assert(out_decoded_len);
-
-    string body = {body_data, body_len};
+// Trailer field after the last chunk (RFC 9112 section 7.1.2), only checked, not output
+static bool is_trailer_line(string line) {
+    size_t name_len = index_of_non_token(line);
+    return name_len > 0 && name_len < line.count && line.data[name_len] == ':' &&
+           index_of_control(line) == line.count;
+}
 
-    size_t decoded_len = 0;
+// 
+// out_consumed is the size of the chunked body itself, including the last chunk and trailer fields.
+// 
+static http_parsing_result_t decode_chunked(string body, chunked_output_t* out, size_t* out_consumed) {
+    const char* body_start = body.data;
 
-    while (body.count > 0) {
-        string length_str = eat_line(&body);
+    for (;;) {
+        string size_line;
+        if (!eat_complete_line(&body, &size_line)) {
+            return PARSING_RES_NOT_ENOUGH_DATA;
+        }
 
-        bool done;
-        uint32_t length = hex_to_u32(length_str, &done);
-        if (!done) {
+        uint64_t length;
+        if (parse_chunk_size_line(size_line, &length) != PARSING_RES_SUCCEEDED) {
             return PARSING_RES_FAILED;
         }
 
         // Stop when encounter zero
         if (length == 0) {
-            // There has to be another empty line
-            if (body.count == 0) {
-                return PARSING_RES_NOT_ENOUGH_DATA;
-            }
-
-            string empty_line = eat_line(&body);
-            if (empty_line.count == 0) {
-                *out_decoded_len = decoded_len;
-                return PARSING_RES_SUCCEEDED;
-            } else {
-                return PARSING_RES_FAILED;
-            }
+            break;
         }
 
         if (body.count < length) {
             return PARSING_RES_NOT_ENOUGH_DATA;
         }
 
-        for (size_t i = 0; i < length; i++) {
-            if (decoded_len >= buf_len) {
-                return PARSING_RES_NOT_ENOUGH_MEMORY;
-            }
-            buf[decoded_len] = body.data[i];
-            decoded_len++;
+        http_parsing_result_t res = output_chunk(out, eat_until(&body, (size_t) length));
+        if (res != PARSING_RES_SUCCEEDED) {
+            return res;
         }
 
-        body.data += length;
-        body.count -= length;
-
-        // Skip newline
-        // TODO: CRLF
+        // Skip newline (LF or CRLF)
+        if (body.count > 0 && *body.data == '\r') {
+            body.data++;
+            body.count--;
+        }
         if (body.count == 0) {
             return PARSING_RES_NOT_ENOUGH_DATA;
         }
@@ -468,6 +575,2245 @@ http_parsing_result_t http_decode_chunked(const char* body_data, size_t body_len
         body.count--;
     }
 
-    // Didn't find a line with a zero
-    return PARSING_RES_NOT_ENOUGH_DATA;
+    // Trailer fields until an empty line
+    for (;;) {
+        string line;
+        if (!eat_complete_line(&body, &line)) {
+            return PARSING_RES_NOT_ENOUGH_DATA;
+        }
+        if (line.count == 0) {
+            *out_consumed = (size_t) (body.data - body_start);
+            return PARSING_RES_SUCCEEDED;
+        }
+        if (!is_trailer_line(line)) {
+            return PARSING_RES_FAILED;
+        }
+    }
+}
+
+// 
+// Everything needed to parse one message. One-shot and incremental parsing share this,
+// the only difference is the state: one-shot parsing starts from a fresh one every time.
+// 
+typedef struct {
+    http_parser_state_t* state;
+
+    // The whole message received so far, starting from its first byte.
+    string text;
+
+    // No more data will be appended to text, so a line without a newline at the end
+    // is parsed as is instead of waiting for the rest of it.
+    bool final;
+
+    // Exactly one of these is set.
+    http_request_t*  out_req;
+    http_response_t* out_resp;
+
+    // Exactly one of these is set, headers_max_len is the size of it.
+    http_header_t* headers_buf;
+    http_compact_header_t* compact_headers_buf;
+    size_t headers_max_len;
+
+    // If set, headers_buf was allocated from it and is made bigger when it's full.
+    http_arena_t* arena;
+
+    // If set, parts of the message are passed to these instead, nothing is stored in headers_buf.
+    const http_parser_callbacks_t* callbacks;
+    void* user_data;
+
+    // If set, the body ends where Content-Length/Transfer-Encoding say it does,
+    // and this is the size of the whole message.
+    size_t* out_consumed;
+} message_parser_t;
+
+// 
+// The end of the line is found by searching for control characters, so the line is checked
+// for ones that aren't allowed in the same pass. Only '\t' may be in it, '\r' only right before '\n'.
+// Search starts at scanned, *out_line_len is where the line ending starts, or where to continue
+// searching when there's no line ending yet (rest.count, or a '\r' at the end).
+// 
+static http_parsing_result_t find_line_end(string rest, size_t scanned, size_t* out_line_len) {
+    string unscanned = {rest.data + scanned, rest.count - scanned};
+    size_t line_len = scanned + index_of_control(unscanned);
+    *out_line_len = line_len;
+
+    if (line_len == rest.count) {
+        return PARSING_RES_NOT_ENOUGH_DATA;
+    }
+    if (rest.data[line_len] == '\r') {
+        if (line_len + 1 == rest.count) {
+            // '\n' may come next, look at '\r' again then
+            return PARSING_RES_NOT_ENOUGH_DATA;
+        }
+        return rest.data[line_len + 1] == '\n' ? PARSING_RES_SUCCEEDED : PARSING_RES_FAILED;
+    }
+    return rest.data[line_len] == '\n' ? PARSING_RES_SUCCEEDED : PARSING_RES_FAILED;
+}
+
+static size_t line_ending_size(string rest, size_t line_len) {
+    return rest.data[line_len] == '\r' ? 2 : 1;
+}
+
+// 
+// Finds the line at the current offset. Returns PARSING_RES_NOT_ENOUGH_DATA if there's nothing to parse yet,
+// PARSING_RES_FAILED if the line has characters that aren't allowed in it.
+// Bytes that were already searched for a newline by a previous call aren't searched again.
+// 
+static http_parsing_result_t peek_line(message_parser_t* p, string* out_line, size_t* out_line_size) {
+    http_parser_state_t* state = p->state;
+
+    string rest = {p->text.data + state->offset, p->text.count - state->offset};
+    if (rest.count == 0) {
+        return PARSING_RES_NOT_ENOUGH_DATA;
+    }
+
+    size_t line_len;
+    http_parsing_result_t res = find_line_end(rest, state->scanned, &line_len);
+    if (res == PARSING_RES_FAILED) {
+        return res;
+    }
+    state->scanned = line_len;
+
+    size_t line_size = line_len;
+    if (res == PARSING_RES_SUCCEEDED) {
+        // Include line ending.
+        line_size += line_ending_size(rest, line_len);
+    } else if (line_len < rest.count || !p->final) {
+        // Final text can end without a line ending, but not with a '\r'
+        return PARSING_RES_NOT_ENOUGH_DATA;
+    }
+
+    *out_line      = (string) {rest.data, line_len};
+    *out_line_size = line_size;
+    return PARSING_RES_SUCCEEDED;
+}
+
+static void skip_line(message_parser_t* p, size_t line_size) {
+    p->state->offset += line_size;
+    p->state->scanned = 0;
+}
+
+// 
+// The line wasn't skipped, so it will be looked at again once there's more data.
+// If there already is more data after it, it can't be completed anymore.
+// 
+static http_parsing_result_t line_result(message_parser_t* p, http_parsing_result_t res, size_t line_size) {
+    if (res == PARSING_RES_NOT_ENOUGH_DATA && p->state->offset + line_size < p->text.count) {
+        return PARSING_RES_FAILED;
+    }
+    return res;
+}
+
+static http_parsing_result_t parse_start_line(message_parser_t* p) {
+    string line;
+    size_t line_size;
+    http_parsing_result_t res = peek_line(p, &line, &line_size);
+    if (res != PARSING_RES_SUCCEEDED) {
+        return res;
+    }
+
+    if (p->out_req) {
+        res = parse_request_line(line, p->out_req);
+    } else {
+        res = parse_status_line(line, p->out_resp);
+    }
+
+    if (res != PARSING_RES_SUCCEEDED) {
+        return line_result(p, res, line_size);
+    }
+
+    skip_line(p, line_size);
+    p->state->stage = HTTP_PARSER_STAGE_HEADERS;
+    return PARSING_RES_SUCCEEDED;
+}
+
+static size_t arena_padding(const http_arena_t* arena, size_t align) {
+    return (size_t) (-(uintptr_t) (arena->data + arena->used)) & (align - 1);
+}
+
+// 
+// Changes size of the last allocation without moving it, if there's room after it.
+// 
+static bool arena_resize(http_arena_t* arena, void* ptr, size_t old_size, size_t new_size) {
+    if ((char*) ptr + old_size != arena->data + arena->used) {
+        return false;
+    }
+    if (new_size > old_size && new_size - old_size > arena->size - arena->used) {
+        return false;
+    }
+
+    arena->used = arena->used - old_size + new_size;
+    return true;
+}
+
+// 
+// Doubles the header array. It usually is the last thing in the arena and just grows in place,
+// otherwise the headers parsed so far are copied to a new array, they are never parsed again.
+// 
+static bool grow_headers(message_parser_t* p) {
+    http_arena_t* arena = p->arena;
+    size_t new_max_len = p->headers_max_len * 2;
+
+    if (arena_resize(arena, p->headers_buf, p->headers_max_len * sizeof(http_header_t), new_max_len * sizeof(http_header_t))) {
+        p->headers_max_len = new_max_len;
+        return true;
+    }
+
+    http_header_t* new_buf = http_arena_alloc(arena, new_max_len * sizeof(http_header_t), _Alignof(http_header_t));
+    if (!new_buf) {
+        return false;
+    }
+
+    memcpy(new_buf, p->headers_buf, p->state->headers_len * sizeof(http_header_t));
+    p->headers_buf     = new_buf;
+    p->headers_max_len = new_max_len;
+    return true;
+}
+
+static http_parsing_result_t store_header(message_parser_t* p, string name, string value, http_header_id_t id) {
+    http_parser_state_t* state = p->state;
+    http_header_t* header = &p->headers_buf[state->headers_len];
+
+    header->name     = name.data;
+    header->name_len = name.count;
+
+    header->value     = value.data;
+    header->value_len = value.count;
+
+    header->id = id;
+
+    if (state->index) {
+        header_index_insert(state->index, state->headers_len, header_name_hash(name, id));
+    }
+    return PARSING_RES_SUCCEEDED;
+}
+
+// 
+// Only the offset of the name is stored, the value is found again by skipping the colon
+// and the whitespace after it. Headers that don't fit into the compact fields are rejected.
+// 
+static http_parsing_result_t store_compact_header(message_parser_t* p, string name, string value) {
+    size_t offset = (size_t) (name.data - p->text.data);
+    if (offset > UINT32_MAX || name.count > UINT16_MAX || value.count > UINT16_MAX) {
+        return PARSING_RES_FAILED;
+    }
+
+    http_compact_header_t* header = &p->compact_headers_buf[p->state->headers_len];
+
+    header->offset    = (uint32_t) offset;
+    header->name_len  = (uint16_t) name.count;
+    header->value_len = (uint16_t) value.count;
+    return PARSING_RES_SUCCEEDED;
+}
+
+static http_parsing_result_t callback_result(int stop) {
+    return stop ? PARSING_RES_STOPPED : PARSING_RES_SUCCEEDED;
+}
+
+static http_parsing_result_t emit_start_line(message_parser_t* p) {
+    const http_parser_callbacks_t* cb = p->callbacks;
+
+    if (p->out_req) {
+        if (cb->on_method && cb->on_method(p->user_data, p->out_req->method, p->out_req->method_len)) {
+            return PARSING_RES_STOPPED;
+        }
+        if (cb->on_target && cb->on_target(p->user_data, p->out_req->target, p->out_req->target_len)) {
+            return PARSING_RES_STOPPED;
+        }
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    if (cb->on_status) {
+        return callback_result(cb->on_status(p->user_data, p->out_resp->status_code,
+                                             p->out_resp->status_text, p->out_resp->status_text_len));
+    }
+    return PARSING_RES_SUCCEEDED;
+}
+
+static http_parsing_result_t emit_header(message_parser_t* p, string name, string value, http_header_id_t id) {
+    if (!p->callbacks->on_header) {
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    http_header_t header;
+    header.name      = name.data;
+    header.name_len  = name.count;
+    header.value     = value.data;
+    header.value_len = value.count;
+    header.id        = id;
+
+    return callback_result(p->callbacks->on_header(p->user_data, &header));
+}
+
+static http_message_info_t* message_info(message_parser_t* p) {
+    return p->out_req ? &p->out_req->info : &p->out_resp->info;
+}
+
+// Only the last coding matters, it has to be chunked for the length to be known
+static bool last_coding_is_chunked(string codings) {
+    size_t comma;
+    while ((comma = index_of_char(codings, ',')) < codings.count) {
+        codings.data  += comma + 1;
+        codings.count -= comma + 1;
+    }
+    eat_whitespace(&codings);
+    codings.count = index_of_whitespace_class(codings, true);
+
+    return strings_match_ignore_case(codings, STR("chunked"));
+}
+
+static void note_connection_options(http_message_info_t* info, string options) {
+    while (options.count > 0) {
+        string option = eat_until(&options, index_of_char(options, ','));
+        eat_whitespace(&option);
+        option.count = index_of_whitespace_class(option, true);
+
+        if (strings_match_ignore_case(option, STR("close"))) {
+            info->connection_close = true;
+        } else if (strings_match_ignore_case(option, STR("keep-alive"))) {
+            info->connection_keep_alive = true;
+        } else if (strings_match_ignore_case(option, STR("upgrade"))) {
+            info->connection_upgrade = true;
+        }
+
+        // Skip comma.
+        if (options.count > 0) {
+            options.data++;
+            options.count--;
+        }
+    }
+}
+
+static void note_header(http_message_info_t* info, http_header_id_t id, string value) {
+    switch (id) {
+        case HTTP_HEADER_CONTENT_LENGTH: {
+            bool done;
+            uint64_t length = string_to_u64(value, &done);
+            if (!done || (info->has_content_length && length != info->content_length)) {
+                info->invalid_content_length = true;
+            } else if (info->has_content_length) {
+                info->duplicate_content_length = true;
+            }
+            info->has_content_length = true;
+            info->content_length = length;
+            break;
+        }
+
+        case HTTP_HEADER_TRANSFER_ENCODING:
+            // Every repetition adds codings, so the last one has the last coding
+            info->has_transfer_encoding = true;
+            info->chunked = last_coding_is_chunked(value);
+            break;
+
+        case HTTP_HEADER_CONNECTION:
+            note_connection_options(info, value);
+            break;
+
+        case HTTP_HEADER_UPGRADE:
+            info->upgrade     = value.data;
+            info->upgrade_len = value.count;
+            break;
+
+        case HTTP_HEADER_EXPECT:
+            info->expect_continue = strings_match_ignore_case(value, STR("100-continue"));
+            break;
+
+        default:
+            break;
+    }
+}
+
+static bool response_has_no_body(uint16_t status_code) {
+    return (status_code >= 100 && status_code < 200) || status_code == 204 || status_code == 304;
+}
+
+// Decisions that depend on more than one header
+static void finish_message_info(message_parser_t* p) {
+    http_message_info_t* info = message_info(p);
+
+    string protocol = p->out_req ? (string) {p->out_req->protocol, p->out_req->protocol_len}
+                                 : (string) {p->out_resp->protocol, p->out_resp->protocol_len};
+    if (strings_match(protocol, STR("HTTP/1.1"))) {
+        info->keep_alive = !info->connection_close;
+    } else {
+        info->keep_alive = info->connection_keep_alive && !info->connection_close;
+    }
+
+    bool length_known = info->has_transfer_encoding ? info->chunked : info->has_content_length;
+    if (p->out_req) {
+        // Without any of them there is no body, but with other codings the length can't be found
+        length_known = length_known || !info->has_transfer_encoding;
+    } else if (response_has_no_body(p->out_resp->status_code)) {
+        length_known = true;
+    }
+    if (!length_known) {
+        info->keep_alive = false;
+    }
+
+    info->upgrade_requested = info->upgrade != NULL && info->connection_upgrade;
+    info->length_conflict = info->has_content_length && info->has_transfer_encoding;
+}
+
+// Parses one header line, or the blank line after the headers, which ends the stage
+static http_parsing_result_t parse_next_header(message_parser_t* p) {
+    http_parser_state_t* state = p->state;
+
+    string line;
+    size_t line_size;
+    http_parsing_result_t res = peek_line(p, &line, &line_size);
+    if (res != PARSING_RES_SUCCEEDED) {
+        // Didn't encounter a blank line, or the line has invalid characters
+        return res;
+    }
+
+    if (line.count == 0) {
+        // Encountered a blank line
+        finish_message_info(p);
+        skip_line(p, line_size);
+        state->stage = HTTP_PARSER_STAGE_DONE;
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    string header_name;
+    string header_value;
+    res = parse_header_line(line, &header_name, &header_value);
+    if (res != PARSING_RES_SUCCEEDED) {
+        return line_result(p, res, line_size);
+    }
+
+    http_header_id_t id = header_id(header_name);
+
+    if (p->callbacks) {
+        res = emit_header(p, header_name, header_value, id);
+    } else if (state->headers_len >= p->headers_max_len && !(p->arena && grow_headers(p))) {
+        // Ran out of memory.
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    } else if (p->compact_headers_buf) {
+        res = store_compact_header(p, header_name, header_value);
+    } else {
+        res = store_header(p, header_name, header_value, id);
+    }
+    if (res != PARSING_RES_SUCCEEDED) {
+        return res;
+    }
+
+    note_header(message_info(p), id, header_value);
+    state->headers_len++;
+    skip_line(p, line_size);
+    return PARSING_RES_SUCCEEDED;
+}
+
+static http_parsing_result_t parse_header_lines(message_parser_t* p) {
+    while (p->state->stage == HTTP_PARSER_STAGE_HEADERS) {
+        http_parsing_result_t res = parse_next_header(p);
+        if (res != PARSING_RES_SUCCEEDED) {
+            return res;
+        }
+    }
+    return PARSING_RES_SUCCEEDED;
+}
+
+static http_parsing_result_t parse_headers(message_parser_t* p) {
+    HTTP_PROBE2(headers__start, p->state->offset, p->text.data);
+    http_parsing_result_t res = parse_header_lines(p);
+    HTTP_PROBE4(headers__done, p->state->offset, p->state->headers_len, (int) res, p->text.data);
+    return res;
+}
+
+// 
+// Finds out how long the body is, see RFC 9112 section 6.3.
+// Bodies that last until the connection is closed take all of the remaining text.
+// 
+static http_parsing_result_t frame_body(message_parser_t* p, string* body) {
+    const http_message_info_t* info = message_info(p);
+
+    if (info->invalid_content_length) {
+        return PARSING_RES_FAILED;
+    }
+
+    if (p->out_resp && response_has_no_body(p->out_resp->status_code)) {
+        body->count = 0;
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    // Transfer-Encoding overrides Content-Length
+    if (info->has_transfer_encoding) {
+        if (info->chunked) {
+            chunked_output_t out = {0};
+            size_t chunked_len;
+            http_parsing_result_t res = decode_chunked(*body, &out, &chunked_len);
+            if (res != PARSING_RES_SUCCEEDED) {
+                return res;
+            }
+            body->count = chunked_len;
+            return PARSING_RES_SUCCEEDED;
+        }
+
+        if (p->out_req) {
+            // Request length can't be determined
+            return PARSING_RES_FAILED;
+        }
+
+        // Response lasts until the connection is closed
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    if (info->has_content_length) {
+        if (body->count < info->content_length) {
+            return PARSING_RES_NOT_ENOUGH_DATA;
+        }
+        body->count = (size_t) info->content_length;
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    if (p->out_req) {
+        // No body
+        body->count = 0;
+    }
+
+    // Otherwise response lasts until the connection is closed
+    return PARSING_RES_SUCCEEDED;
+}
+
+static void output_headers(message_parser_t* p) {
+    if (p->compact_headers_buf) {
+        // Caller gets the number of headers from the state
+    } else if (p->out_req) {
+        p->out_req->headers      = p->headers_buf;
+        p->out_req->headers_len  = p->state->headers_len;
+        p->out_req->header_index = p->state->index;
+    } else {
+        p->out_resp->headers      = p->headers_buf;
+        p->out_resp->headers_len  = p->state->headers_len;
+        p->out_resp->header_index = p->state->index;
+    }
+}
+
+static http_parsing_result_t parse_message_stages(message_parser_t* p) {
+    http_parser_state_t* state = p->state;
+
+    // Read start line.
+    if (state->stage == HTTP_PARSER_STAGE_START_LINE) {
+        if (state->index) {
+            header_index_clear(state->index);
+        }
+
+        http_parsing_result_t res = parse_start_line(p);
+        if (res == PARSING_RES_SUCCEEDED && p->callbacks) {
+            res = emit_start_line(p);
+        }
+        if (res != PARSING_RES_SUCCEEDED) {
+            return res;
+        }
+    }
+
+    // Read headers.
+    if (state->stage == HTTP_PARSER_STAGE_HEADERS) {
+        http_parsing_result_t res = parse_headers(p);
+        output_headers(p);
+
+        if (res == PARSING_RES_SUCCEEDED && p->callbacks && p->callbacks->on_headers_complete) {
+            res = callback_result(p->callbacks->on_headers_complete(p->user_data));
+        }
+        if (res != PARSING_RES_SUCCEEDED) {
+            return res;
+        }
+    }
+
+    // Remaining text is the body.
+    {
+        string body = {p->text.data + state->offset, p->text.count - state->offset};
+
+        // Body is optional, so don't check for empty
+
+        if (p->out_consumed) {
+            http_parsing_result_t res = frame_body(p, &body);
+            if (res != PARSING_RES_SUCCEEDED) {
+                return res;
+            }
+
+            *p->out_consumed = state->offset + body.count;
+        }
+
+        if (p->out_req) {
+            p->out_req->body     = body.data;
+            p->out_req->body_len = body.count;
+        } else {
+            p->out_resp->body     = body.data;
+            p->out_resp->body_len = body.count;
+        }
+
+        if (p->callbacks && p->callbacks->on_body && body.count > 0) {
+            return callback_result(p->callbacks->on_body(p->user_data, body.data, body.count));
+        }
+    }
+
+    return PARSING_RES_SUCCEEDED;
+}
+
+#if defined(HTTP_PARSER_STATS)
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+static THREAD_LOCAL http_parser_stats_t thread_stats;
+
+static size_t histogram_bucket(size_t value, size_t first_limit) {
+    size_t bucket = 0;
+    for (size_t limit = first_limit; value >= limit && bucket + 1 < HTTP_PARSER_STATS_BUCKETS; limit *= 2) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void count_result(http_parsing_result_t res, http_parser_failure_t failure) {
+    switch (res) {
+        case PARSING_RES_NOT_ENOUGH_DATA:   thread_stats.not_enough_data++;   break;
+        case PARSING_RES_NOT_ENOUGH_MEMORY: thread_stats.not_enough_memory++; break;
+        case PARSING_RES_STOPPED:           thread_stats.stopped++;           break;
+        case PARSING_RES_FAILED:            thread_stats.failures[failure]++; break;
+        default:                                                              break;
+    }
+}
+
+static void count_message(const message_parser_t* p, size_t start_offset, http_parsing_result_t res) {
+    const http_parser_state_t* state = p->state;
+
+    if (res != PARSING_RES_SUCCEEDED) {
+        thread_stats.bytes_scanned += p->text.count - start_offset;
+
+        http_parser_failure_t failure = HTTP_PARSER_FAILURE_FRAMING;
+        if (state->stage == HTTP_PARSER_STAGE_START_LINE) {
+            failure = HTTP_PARSER_FAILURE_START_LINE;
+        } else if (state->stage == HTTP_PARSER_STAGE_HEADERS) {
+            failure = HTTP_PARSER_FAILURE_HEADER;
+        }
+        count_result(res, failure);
+        return;
+    }
+
+    // Framed messages end where their body does, others take the whole text
+    size_t end = p->out_consumed ? *p->out_consumed : p->text.count;
+    thread_stats.bytes_scanned += end - start_offset;
+    thread_stats.messages++;
+    thread_stats.header_count[histogram_bucket(state->headers_len, HTTP_PARSER_STATS_HEADER_COUNT_FIRST_LIMIT)]++;
+    thread_stats.header_size[histogram_bucket(state->offset, HTTP_PARSER_STATS_HEADER_SIZE_FIRST_LIMIT)]++;
+}
+
+static void count_chunked(size_t body_len, http_parsing_result_t res) {
+    thread_stats.bytes_scanned += body_len;
+    if (res == PARSING_RES_SUCCEEDED) {
+        thread_stats.chunked_bodies++;
+    } else {
+        count_result(res, HTTP_PARSER_FAILURE_CHUNKED);
+    }
+}
+
+#define COUNT_MESSAGE(p, start_offset, res) count_message(p, start_offset, res)
+#define COUNT_CHUNKED(body_len, res) count_chunked(body_len, res)
+
+#else
+
+// Nothing is counted, so there's not even a call
+#define COUNT_MESSAGE(p, start_offset, res) ((void) (start_offset))
+#define COUNT_CHUNKED(body_len, res) ((void) 0)
+
+#endif
+
+// Every parsing function but http_parse_requests_multi and http_parse_request_lazy goes through here
+static http_parsing_result_t parse_message(message_parser_t* p) {
+    size_t start_offset = p->state->offset;
+    if (p->out_req) {
+        HTTP_PROBE2(request__start, p->text.count, p->text.data);
+    } else {
+        HTTP_PROBE2(response__start, p->text.count, p->text.data);
+    }
+
+    http_parsing_result_t res = parse_message_stages(p);
+    COUNT_MESSAGE(p, start_offset, res);
+
+    if (p->out_req) {
+        HTTP_PROBE4(request__done, p->text.count, p->state->headers_len, (int) res, p->text.data);
+    } else {
+        HTTP_PROBE4(response__done, p->text.count, p->state->headers_len, (int) res, p->text.data);
+    }
+    return res;
+}
+
+bool http_parser_stats_get(http_parser_stats_t *out_stats) {
+    assert(out_stats);
+
+#if defined(HTTP_PARSER_STATS)
+    *out_stats = thread_stats;
+    return true;
+#else
+    *out_stats = (http_parser_stats_t) {0};
+    return false;
+#endif
+}
+
+void http_parser_stats_reset(void) {
+#if defined(HTTP_PARSER_STATS)
+    thread_stats = (http_parser_stats_t) {0};
+#endif
+}
+
+void http_parser_stats_add(http_parser_stats_t *total, const http_parser_stats_t *stats) {
+    assert(total);
+    assert(stats);
+
+    total->bytes_scanned     += stats->bytes_scanned;
+    total->messages          += stats->messages;
+    total->chunked_bodies    += stats->chunked_bodies;
+    total->not_enough_data   += stats->not_enough_data;
+    total->not_enough_memory += stats->not_enough_memory;
+    total->stopped           += stats->stopped;
+    for (size_t i = 0; i < HTTP_PARSER_FAILURE_COUNT; i++) {
+        total->failures[i] += stats->failures[i];
+    }
+    for (size_t i = 0; i < HTTP_PARSER_STATS_BUCKETS; i++) {
+        total->header_count[i] += stats->header_count[i];
+        total->header_size[i]  += stats->header_size[i];
+    }
+}
+
+void http_parser_state_init(http_parser_state_t *state) {
+    assert(state);
+
+    *state = (http_parser_state_t) {0};
+    state->stage = HTTP_PARSER_STAGE_START_LINE;
+}
+
+http_parsing_result_t http_parse_response(const char *text_data, size_t text_len,
+                                          http_header_t *headers_buf, size_t headers_max_len,
+                                          http_response_t *out_resp) {
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_resp);
+
+    *out_resp = (http_response_t) {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state           = &state;
+    parser.text            = (string) {text_data, text_len};
+    parser.final           = true;
+    parser.out_resp        = out_resp;
+    parser.headers_buf     = headers_buf;
+    parser.headers_max_len = headers_max_len;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_request(const char *text_data, size_t text_len,
+                                         http_header_t *headers_buf, size_t headers_max_len,
+                                         http_request_t *out_req) {
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_req);
+
+    *out_req = (http_request_t) {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state           = &state;
+    parser.text            = (string) {text_data, text_len};
+    parser.final           = true;
+    parser.out_req         = out_req;
+    parser.headers_buf     = headers_buf;
+    parser.headers_max_len = headers_max_len;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_response_framed(const char *text_data, size_t text_len,
+                                                 http_header_t *headers_buf, size_t headers_max_len,
+                                                 http_response_t *out_resp, size_t *out_consumed) {
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_resp);
+    assert(out_consumed);
+
+    *out_resp = (http_response_t) {0};
+    *out_consumed = 0;
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state           = &state;
+    parser.text            = (string) {text_data, text_len};
+    parser.final           = true;
+    parser.out_resp        = out_resp;
+    parser.headers_buf     = headers_buf;
+    parser.headers_max_len = headers_max_len;
+    parser.out_consumed    = out_consumed;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_request_framed(const char *text_data, size_t text_len,
+                                                http_header_t *headers_buf, size_t headers_max_len,
+                                                http_request_t *out_req, size_t *out_consumed) {
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_req);
+    assert(out_consumed);
+
+    *out_req = (http_request_t) {0};
+    *out_consumed = 0;
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state           = &state;
+    parser.text            = (string) {text_data, text_len};
+    parser.final           = true;
+    parser.out_req         = out_req;
+    parser.headers_buf     = headers_buf;
+    parser.headers_max_len = headers_max_len;
+    parser.out_consumed    = out_consumed;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_response_cb(const char *text_data, size_t text_len,
+                                             const http_parser_callbacks_t *callbacks, void *user_data) {
+    assert(text_data);
+    assert(callbacks);
+
+    // Start line is parsed into it before it's passed to callbacks
+    http_response_t resp = {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state     = &state;
+    parser.text      = (string) {text_data, text_len};
+    parser.final     = true;
+    parser.out_resp  = &resp;
+    parser.callbacks = callbacks;
+    parser.user_data = user_data;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_request_cb(const char *text_data, size_t text_len,
+                                            const http_parser_callbacks_t *callbacks, void *user_data) {
+    assert(text_data);
+    assert(callbacks);
+
+    // Start line is parsed into it before it's passed to callbacks
+    http_request_t req = {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state     = &state;
+    parser.text      = (string) {text_data, text_len};
+    parser.final     = true;
+    parser.out_req   = &req;
+    parser.callbacks = callbacks;
+    parser.user_data = user_data;
+
+    return parse_message(&parser);
+}
+
+// Start of every block from grow, the allocations follow it
+typedef struct arena_block {
+    struct arena_block* prev;
+    size_t size;
+} arena_block_t;
+
+void http_arena_init(http_arena_t *arena, void *data, size_t size,
+                     http_arena_grow_t grow, http_arena_release_t release, void *user_data) {
+    assert(arena);
+    assert(data || size == 0);
+
+    arena->data         = data;
+    arena->size         = size;
+    arena->used         = 0;
+    arena->initial_data = data;
+    arena->initial_size = size;
+    arena->blocks       = NULL;
+    arena->grow         = grow;
+    arena->release      = release;
+    arena->user_data    = user_data;
+}
+
+void *http_arena_alloc(http_arena_t *arena, size_t size, size_t align) {
+    assert(arena);
+    assert(align > 0 && (align & (align - 1)) == 0);
+
+    size_t padding = arena_padding(arena, align);
+    if (padding + size > arena->size - arena->used) {
+        if (!arena->grow) {
+            return NULL;
+        }
+
+        // Continue in a new block, the old one still holds earlier allocations
+        size_t min_size = sizeof(arena_block_t) + size + align - 1;
+        size_t new_size = 0;
+        arena_block_t* block = arena->grow(arena->user_data, min_size, &new_size);
+        if (!block || new_size < min_size) {
+            return NULL;
+        }
+
+        block->prev   = arena->blocks;
+        block->size   = new_size;
+        arena->blocks = block;
+
+        arena->data = (char*) (block + 1);
+        arena->size = new_size - sizeof(arena_block_t);
+        arena->used = 0;
+        padding = arena_padding(arena, align);
+    }
+
+    void* result = arena->data + arena->used + padding;
+    arena->used += padding + size;
+    return result;
+}
+
+void http_arena_reset(http_arena_t *arena) {
+    assert(arena);
+
+    while (arena->blocks) {
+        arena_block_t* block = arena->blocks;
+        arena->blocks = block->prev;
+        if (arena->release) {
+            arena->release(arena->user_data, block, block->size);
+        }
+    }
+
+    arena->data = arena->initial_data;
+    arena->size = arena->initial_size;
+    arena->used = 0;
+}
+
+#define ARENA_INITIAL_HEADERS 16
+
+static http_parsing_result_t parse_message_in_arena(message_parser_t* p, http_arena_t* arena) {
+    p->arena           = arena;
+    p->headers_max_len = ARENA_INITIAL_HEADERS;
+    p->headers_buf     = http_arena_alloc(arena, p->headers_max_len * sizeof(http_header_t), _Alignof(http_header_t));
+    if (!p->headers_buf) {
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    }
+
+    http_parsing_result_t res = parse_message(p);
+
+    // Give back the part of the header array that isn't used
+    arena_resize(arena, p->headers_buf, p->headers_max_len * sizeof(http_header_t), p->state->headers_len * sizeof(http_header_t));
+    return res;
+}
+
+http_parsing_result_t http_parse_response_arena(const char *text_data, size_t text_len,
+                                                http_arena_t *arena, http_response_t *out_resp) {
+    assert(text_data);
+    assert(arena);
+    assert(out_resp);
+
+    *out_resp = (http_response_t) {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state    = &state;
+    parser.text     = (string) {text_data, text_len};
+    parser.final    = true;
+    parser.out_resp = out_resp;
+
+    return parse_message_in_arena(&parser, arena);
+}
+
+http_parsing_result_t http_parse_request_arena(const char *text_data, size_t text_len,
+                                               http_arena_t *arena, http_request_t *out_req) {
+    assert(text_data);
+    assert(arena);
+    assert(out_req);
+
+    *out_req = (http_request_t) {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state   = &state;
+    parser.text    = (string) {text_data, text_len};
+    parser.final   = true;
+    parser.out_req = out_req;
+
+    return parse_message_in_arena(&parser, arena);
+}
+
+http_parsing_result_t http_parse_requests_batch(const char *text_data, size_t text_len,
+                                                http_header_t *headers_pool, size_t pool_len,
+                                                http_request_t *out_reqs, size_t max_reqs,
+                                                size_t *out_count, size_t *out_consumed) {
+    assert(text_data);
+    assert(headers_pool);
+    assert(out_reqs);
+    assert(out_count);
+    assert(out_consumed);
+
+    size_t count = 0;
+    size_t consumed = 0;
+    size_t pool_used = 0;
+
+    http_parser_state_t state;
+
+    // Only the parts that change from one request to the next are updated
+    message_parser_t parser = {0};
+    parser.state = &state;
+    parser.final = true;
+
+    http_parsing_result_t res = PARSING_RES_NOT_ENOUGH_DATA;
+    while (consumed < text_len) {
+        if (count == max_reqs) {
+            res = PARSING_RES_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        http_request_t* req = &out_reqs[count];
+        *req = (http_request_t) {0};
+
+        size_t req_consumed = 0;
+
+        http_parser_state_init(&state);
+        parser.text            = (string) {text_data + consumed, text_len - consumed};
+        parser.out_req         = req;
+        parser.headers_buf     = headers_pool + pool_used;
+        parser.headers_max_len = pool_len - pool_used;
+        parser.out_consumed    = &req_consumed;
+
+        res = parse_message(&parser);
+        if (res != PARSING_RES_SUCCEEDED) {
+            break;
+        }
+
+        pool_used += req->headers_len;
+        consumed  += req_consumed;
+        count++;
+    }
+
+    *out_count    = count;
+    *out_consumed = consumed;
+
+    if (res == PARSING_RES_FAILED) {
+        return PARSING_RES_FAILED;
+    }
+    if (count > 0) {
+        return PARSING_RES_SUCCEEDED;
+    }
+    return res;
+}
+
+#define MULTI_MAX_LANES 64
+
+// 
+// Takes every request in the group one line further per round. Requests that end or fail drop out of the round.
+// 
+static size_t parse_requests_lockstep(const char *const *texts, const size_t *text_lens, size_t n,
+                                      http_header_t *headers_pool, size_t headers_per_request,
+                                      http_request_t *out_reqs, http_parsing_result_t *out_results) {
+    http_parser_state_t states[MULTI_MAX_LANES];
+    message_parser_t parsers[MULTI_MAX_LANES];
+    uint8_t active[MULTI_MAX_LANES];
+    size_t active_len = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        assert(texts[i]);
+
+        out_reqs[i] = (http_request_t) {0};
+        http_parser_state_init(&states[i]);
+
+        parsers[i] = (message_parser_t) {0};
+        parsers[i].state           = &states[i];
+        parsers[i].text            = (string) {texts[i], text_lens[i]};
+        parsers[i].final           = true;
+        parsers[i].out_req         = &out_reqs[i];
+        parsers[i].headers_buf     = headers_pool + i * headers_per_request;
+        parsers[i].headers_max_len = headers_per_request;
+
+        HTTP_PROBE2(request__start, text_lens[i], texts[i]);
+        active[active_len++] = (uint8_t) i;
+    }
+
+    size_t succeeded = 0;
+    while (active_len > 0) {
+        size_t still_active = 0;
+        for (size_t j = 0; j < active_len; j++) {
+            message_parser_t* p = &parsers[active[j]];
+
+            // Header probes of every request, like parse_headers, but the blocks overlap
+            http_parsing_result_t res;
+            if (p->state->stage == HTTP_PARSER_STAGE_START_LINE) {
+                res = parse_start_line(p);
+                if (res == PARSING_RES_SUCCEEDED) {
+                    HTTP_PROBE2(headers__start, p->state->offset, p->text.data);
+                }
+            } else {
+                res = parse_next_header(p);
+                if (res != PARSING_RES_SUCCEEDED || p->state->stage == HTTP_PARSER_STAGE_DONE) {
+                    HTTP_PROBE4(headers__done, p->state->offset, p->state->headers_len, (int) res, p->text.data);
+                }
+            }
+            if (res == PARSING_RES_SUCCEEDED && p->state->stage != HTTP_PARSER_STAGE_DONE) {
+                active[still_active++] = active[j];
+                continue;
+            }
+
+            if (p->state->stage != HTTP_PARSER_STAGE_START_LINE) {
+                output_headers(p);
+            }
+            if (res == PARSING_RES_SUCCEEDED) {
+                // Only the body is left
+                res = parse_message_stages(p);
+                succeeded++;
+            }
+            COUNT_MESSAGE(p, 0, res);
+            HTTP_PROBE4(request__done, p->text.count, p->state->headers_len, (int) res, p->text.data);
+            out_results[active[j]] = res;
+        }
+        active_len = still_active;
+    }
+    return succeeded;
+}
+
+size_t http_parse_requests_multi(const char *const *texts, const size_t *text_lens, size_t n,
+                                 http_header_t *headers_pool, size_t headers_per_request,
+                                 http_request_t *out_reqs, http_parsing_result_t *out_results) {
+    assert(texts || n == 0);
+    assert(text_lens || n == 0);
+    assert(headers_pool || n == 0);
+    assert(out_reqs || n == 0);
+    assert(out_results || n == 0);
+
+    size_t succeeded = 0;
+    for (size_t i = 0; i < n; i += MULTI_MAX_LANES) {
+        size_t group = n - i < MULTI_MAX_LANES ? n - i : MULTI_MAX_LANES;
+        succeeded += parse_requests_lockstep(texts + i, text_lens + i, group,
+                                             headers_pool + i * headers_per_request, headers_per_request,
+                                             out_reqs + i, out_results + i);
+    }
+    return succeeded;
+}
+
+http_parsing_result_t http_parse_response_continue(http_parser_state_t *state,
+                                                   const char *text_data, size_t text_len,
+                                                   http_header_t *headers_buf, size_t headers_max_len,
+                                                   http_response_t *out_resp) {
+    assert(state);
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_resp);
+    assert(text_len >= state->offset);
+
+    if (state->stage == HTTP_PARSER_STAGE_START_LINE) {
+        *out_resp = (http_response_t) {0};
+    }
+
+    message_parser_t parser = {0};
+    parser.state           = state;
+    parser.text            = (string) {text_data, text_len};
+    parser.out_resp        = out_resp;
+    parser.headers_buf     = headers_buf;
+    parser.headers_max_len = headers_max_len;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_request_continue(http_parser_state_t *state,
+                                                  const char *text_data, size_t text_len,
+                                                  http_header_t *headers_buf, size_t headers_max_len,
+                                                  http_request_t *out_req) {
+    assert(state);
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_req);
+    assert(text_len >= state->offset);
+
+    if (state->stage == HTTP_PARSER_STAGE_START_LINE) {
+        *out_req = (http_request_t) {0};
+    }
+
+    message_parser_t parser = {0};
+    parser.state           = state;
+    parser.text            = (string) {text_data, text_len};
+    parser.out_req         = out_req;
+    parser.headers_buf     = headers_buf;
+    parser.headers_max_len = headers_max_len;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_response_compact(const char *text_data, size_t text_len,
+                                                  http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                  http_response_t *out_resp, size_t *out_headers_len) {
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_resp);
+    assert(out_headers_len);
+
+    *out_resp = (http_response_t) {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state               = &state;
+    parser.text                = (string) {text_data, text_len};
+    parser.final               = true;
+    parser.out_resp            = out_resp;
+    parser.compact_headers_buf = headers_buf;
+    parser.headers_max_len     = headers_max_len;
+
+    http_parsing_result_t res = parse_message(&parser);
+    *out_headers_len = state.headers_len;
+    return res;
+}
+
+http_parsing_result_t http_parse_request_compact(const char *text_data, size_t text_len,
+                                                 http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                 http_request_t *out_req, size_t *out_headers_len) {
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_req);
+    assert(out_headers_len);
+
+    *out_req = (http_request_t) {0};
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    message_parser_t parser = {0};
+    parser.state               = &state;
+    parser.text                = (string) {text_data, text_len};
+    parser.final               = true;
+    parser.out_req             = out_req;
+    parser.compact_headers_buf = headers_buf;
+    parser.headers_max_len     = headers_max_len;
+
+    http_parsing_result_t res = parse_message(&parser);
+    *out_headers_len = state.headers_len;
+    return res;
+}
+
+http_parsing_result_t http_parse_response_compact_continue(http_parser_state_t *state,
+                                                           const char *text_data, size_t text_len,
+                                                           http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                           http_response_t *out_resp) {
+    assert(state);
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_resp);
+    assert(text_len >= state->offset);
+
+    if (state->stage == HTTP_PARSER_STAGE_START_LINE) {
+        *out_resp = (http_response_t) {0};
+    }
+
+    message_parser_t parser = {0};
+    parser.state               = state;
+    parser.text                = (string) {text_data, text_len};
+    parser.out_resp            = out_resp;
+    parser.compact_headers_buf = headers_buf;
+    parser.headers_max_len     = headers_max_len;
+
+    return parse_message(&parser);
+}
+
+http_parsing_result_t http_parse_request_compact_continue(http_parser_state_t *state,
+                                                          const char *text_data, size_t text_len,
+                                                          http_compact_header_t *headers_buf, size_t headers_max_len,
+                                                          http_request_t *out_req) {
+    assert(state);
+    assert(text_data);
+    assert(headers_buf);
+    assert(out_req);
+    assert(text_len >= state->offset);
+
+    if (state->stage == HTTP_PARSER_STAGE_START_LINE) {
+        *out_req = (http_request_t) {0};
+    }
+
+    message_parser_t parser = {0};
+    parser.state               = state;
+    parser.text                = (string) {text_data, text_len};
+    parser.out_req             = out_req;
+    parser.compact_headers_buf = headers_buf;
+    parser.headers_max_len     = headers_max_len;
+
+    return parse_message(&parser);
+}
+
+const char *http_compact_header_name(const char *text, const http_compact_header_t *header) {
+    assert(text);
+    assert(header);
+
+    return text + header->offset;
+}
+
+const char *http_compact_header_value(const char *text, const http_compact_header_t *header) {
+    assert(text);
+    assert(header);
+
+    // Skip colon and whitespace, value never starts with whitespace
+    const char* value = text + header->offset + header->name_len + 1;
+    while (is_whitespace(*value)) {
+        value++;
+    }
+    return value;
+}
+
+void http_compact_header_expand(const char *text, const http_compact_header_t *header, http_header_t *out_header) {
+    assert(text);
+    assert(header);
+    assert(out_header);
+
+    out_header->name      = http_compact_header_name(text, header);
+    out_header->name_len  = header->name_len;
+    out_header->value     = http_compact_header_value(text, header);
+    out_header->value_len = header->value_len;
+    out_header->id        = header_id((string) {out_header->name, out_header->name_len});
+}
+
+http_header_id_t http_header_id_lookup(const char *name, size_t name_len) {
+    assert(name || name_len == 0);
+
+    return header_id((string) {name, name_len});
+}
+
+const char *http_header_id_name(http_header_id_t id) {
+    if ((unsigned) id >= HTTP_HEADER_COUNT) {
+        return "";
+    }
+    return header_names[id].name;
+}
+
+void http_header_index_init(http_header_index_t *index, uint32_t *slots, size_t slots_len) {
+    assert(index);
+    assert(slots);
+    assert(slots_len > 0 && (slots_len & (slots_len - 1)) == 0);
+
+    index->slots     = slots;
+    index->slots_len = slots_len;
+    header_index_clear(index);
+}
+
+static void find_all_headers(const http_header_t* headers, size_t headers_len, const http_header_index_t* index,
+                             const char* name, size_t name_len, http_header_find_iter_t* out_iter) {
+    assert(name || name_len == 0);
+    assert(out_iter);
+
+    *out_iter = (http_header_find_iter_t) {0};
+    out_iter->headers     = headers;
+    out_iter->headers_len = headers_len;
+    out_iter->name        = name;
+    out_iter->name_len    = name_len;
+    out_iter->id          = header_id((string) {name, name_len});
+
+    if (index && !index->overflowed) {
+        out_iter->index = index;
+        out_iter->hash  = header_name_hash((string) {name, name_len}, out_iter->id);
+        out_iter->pos   = out_iter->hash & (index->slots_len - 1);
+    }
+}
+
+const http_header_t *http_find_next_header(http_header_find_iter_t *iter) {
+    assert(iter);
+
+    string name = {iter->name, iter->name_len};
+
+    if (!iter->index) {
+        // No index, look at every header
+        while (iter->pos < iter->headers_len) {
+            const http_header_t* header = &iter->headers[iter->pos++];
+            if (header_has_name(header, name, iter->id)) {
+                return header;
+            }
+        }
+        return NULL;
+    }
+
+    // Headers with the same name are further along the same probe sequence, in the order they were inserted
+    size_t mask = iter->index->slots_len - 1;
+    while (iter->probed < iter->index->slots_len) {
+        uint32_t slot = iter->index->slots[iter->pos];
+        if (slot == 0) {
+            return NULL;
+        }
+        iter->pos = (iter->pos + 1) & mask;
+        iter->probed++;
+
+        if ((slot & 0xFFFF0000u) == (iter->hash & 0xFFFF0000u)) {
+            const http_header_t* header = &iter->headers[(slot & 0xFFFFu) - 1];
+            if (header_has_name(header, name, iter->id)) {
+                return header;
+            }
+        }
+    }
+    return NULL;
+}
+
+void http_find_all_headers(const http_request_t *req, const char *name, size_t name_len, http_header_find_iter_t *out_iter) {
+    assert(req);
+
+    find_all_headers(req->headers, req->headers_len, req->header_index, name, name_len, out_iter);
+}
+
+void http_find_all_response_headers(const http_response_t *resp, const char *name, size_t name_len, http_header_find_iter_t *out_iter) {
+    assert(resp);
+
+    find_all_headers(resp->headers, resp->headers_len, resp->header_index, name, name_len, out_iter);
+}
+
+const http_header_t *http_find_header(const http_request_t *req, const char *name, size_t name_len) {
+    http_header_find_iter_t iter;
+    http_find_all_headers(req, name, name_len, &iter);
+    return http_find_next_header(&iter);
+}
+
+const http_header_t *http_find_response_header(const http_response_t *resp, const char *name, size_t name_len) {
+    http_header_find_iter_t iter;
+    http_find_all_response_headers(resp, name, name_len, &iter);
+    return http_find_next_header(&iter);
+}
+
+http_parsing_result_t http_decode_chunked(const char* body_data, size_t body_len,
+                                          char* buf, size_t buf_len,
+                                          size_t* out_decoded_len) {
+    assert(body_data);
+    assert(buf);
+    assert(out_decoded_len);
+
+    chunked_output_t out = {0};
+    out.buf     = buf;
+    out.buf_len = buf_len;
+
+    HTTP_PROBE1(chunked__start, body_len);
+    size_t consumed;
+    http_parsing_result_t res = decode_chunked((string) {body_data, body_len}, &out, &consumed);
+    HTTP_PROBE3(chunked__done, body_len, out.decoded_len, (int) res);
+    COUNT_CHUNKED(body_len, res);
+    if (res == PARSING_RES_SUCCEEDED) {
+        *out_decoded_len = out.decoded_len;
+    }
+    return res;
+}
+
+http_parsing_result_t http_decode_chunked_iov(const char* body_data, size_t body_len,
+                                              struct iovec* iov, size_t iov_max,
+                                              size_t* out_iov_len, size_t* out_decoded_len) {
+    assert(body_data);
+    assert(iov);
+    assert(out_iov_len);
+    assert(out_decoded_len);
+
+    chunked_output_t out = {0};
+    out.iov     = iov;
+    out.iov_max = iov_max;
+
+    HTTP_PROBE1(chunked__start, body_len);
+    size_t consumed;
+    http_parsing_result_t res = decode_chunked((string) {body_data, body_len}, &out, &consumed);
+    HTTP_PROBE3(chunked__done, body_len, out.decoded_len, (int) res);
+    COUNT_CHUNKED(body_len, res);
+    if (res == PARSING_RES_SUCCEEDED) {
+        *out_iov_len     = out.iov_len;
+        *out_decoded_len = out.decoded_len;
+    }
+    return res;
+}
+
+void http_chunked_decoder_init(http_chunked_decoder_t *decoder) {
+    assert(decoder);
+
+    *decoder = (http_chunked_decoder_t) {0};
+    decoder->stage = HTTP_CHUNKED_STAGE_SIZE;
+}
+
+static int hex_digit_value(char ch) {
+    if (is_numeric(ch)) {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+static void end_size_line(http_chunked_decoder_t* decoder) {
+    // Zero size means this was the last chunk, then there has to be an empty line
+    decoder->stage = decoder->remaining > 0 ? HTTP_CHUNKED_STAGE_DATA : HTTP_CHUNKED_STAGE_LAST_LINE;
+    decoder->size_digits = 0;
+}
+
+http_parsing_result_t http_chunked_decoder_feed(http_chunked_decoder_t *decoder,
+                                                const char *data, size_t data_len,
+                                                char *buf, size_t buf_len,
+                                                size_t *out_consumed, size_t *out_decoded_len) {
+    assert(decoder);
+    assert(data || data_len == 0);
+    assert(buf || buf_len == 0);
+    assert(out_consumed);
+    assert(out_decoded_len);
+
+    size_t consumed = 0;
+    size_t decoded_len = 0;
+    http_parsing_result_t res = PARSING_RES_NOT_ENOUGH_DATA;
+
+    while (decoder->stage != HTTP_CHUNKED_STAGE_DONE) {
+        if (consumed == data_len) {
+            res = PARSING_RES_NOT_ENOUGH_DATA;
+            goto out;
+        }
+
+        char ch = data[consumed];
+
+        switch (decoder->stage) {
+            case HTTP_CHUNKED_STAGE_SIZE: {
+                // Digits that are here are converted together, the size may continue in the next piece
+                size_t digits_len = 0;
+                while (consumed + digits_len < data_len && hex_digit_value(data[consumed + digits_len]) >= 0) {
+                    digits_len++;
+                }
+                if (digits_len > 0) {
+                    if (!append_hex_digits(&decoder->remaining, (string) {data + consumed, digits_len})) {
+                        res = PARSING_RES_FAILED;
+                        goto out;
+                    }
+                    decoder->size_digits += digits_len;
+                    consumed += digits_len;
+                    break;
+                }
+
+                if (decoder->size_digits == 0) {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+
+                if (ch == '\r') {
+                    decoder->stage = HTTP_CHUNKED_STAGE_SIZE_LF;
+                } else if (ch == '\n') {
+                    end_size_line(decoder);
+                } else if (ch == ';') {
+                    decoder->stage = HTTP_CHUNKED_STAGE_EXT;
+                } else if (is_blank(ch)) {
+                    decoder->stage = HTTP_CHUNKED_STAGE_SIZE_BWS;
+                } else {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                consumed++;
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_SIZE_BWS: {
+                // Whitespace is only allowed before extensions
+                if (ch == ';') {
+                    decoder->stage = HTTP_CHUNKED_STAGE_EXT;
+                } else if (!is_blank(ch)) {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                consumed++;
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_EXT: {
+                if (ch == '\r') {
+                    decoder->stage = HTTP_CHUNKED_STAGE_SIZE_LF;
+                } else if (ch == '\n') {
+                    end_size_line(decoder);
+                } else if (!http_char_is(ch, HTTP_CHAR_FIELD)) {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                consumed++;
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_SIZE_LF: {
+                if (ch != '\n') {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                end_size_line(decoder);
+                consumed++;
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_DATA: {
+                if (decoded_len == buf_len) {
+                    res = PARSING_RES_NOT_ENOUGH_MEMORY;
+                    goto out;
+                }
+
+                size_t count = data_len - consumed;
+                if (count > buf_len - decoded_len) {
+                    count = buf_len - decoded_len;
+                }
+                if (count > decoder->remaining) {
+                    count = (size_t) decoder->remaining;
+                }
+
+                // buf may be the same as data, output is never ahead of input
+                memmove(buf + decoded_len, data + consumed, count);
+                decoded_len += count;
+                consumed    += count;
+
+                decoder->remaining -= count;
+                if (decoder->remaining == 0) {
+                    decoder->stage = HTTP_CHUNKED_STAGE_DATA_END;
+                }
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_DATA_END:
+            case HTTP_CHUNKED_STAGE_LAST_LINE: {
+                // LF or CRLF
+                bool last = decoder->stage == HTTP_CHUNKED_STAGE_LAST_LINE;
+                if (ch == '\r') {
+                    decoder->stage = last ? HTTP_CHUNKED_STAGE_LAST_LF : HTTP_CHUNKED_STAGE_DATA_LF;
+                } else if (ch == '\n') {
+                    decoder->stage = last ? HTTP_CHUNKED_STAGE_DONE : HTTP_CHUNKED_STAGE_SIZE;
+                } else if (last && http_char_is(ch, HTTP_CHAR_TOKEN)) {
+                    // Trailer field instead of the empty line
+                    decoder->stage = HTTP_CHUNKED_STAGE_TRAILER_NAME;
+                } else {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                consumed++;
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_TRAILER_NAME: {
+                if (ch == ':') {
+                    decoder->stage = HTTP_CHUNKED_STAGE_TRAILER_VALUE;
+                } else if (!http_char_is(ch, HTTP_CHAR_TOKEN)) {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                consumed++;
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_TRAILER_VALUE: {
+                if (ch == '\r') {
+                    decoder->stage = HTTP_CHUNKED_STAGE_TRAILER_LF;
+                } else if (ch == '\n') {
+                    decoder->stage = HTTP_CHUNKED_STAGE_LAST_LINE;
+                } else if (!http_char_is(ch, HTTP_CHAR_FIELD)) {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                consumed++;
+                break;
+            }
+            case HTTP_CHUNKED_STAGE_DATA_LF:
+            case HTTP_CHUNKED_STAGE_TRAILER_LF:
+            case HTTP_CHUNKED_STAGE_LAST_LF: {
+                if (ch != '\n') {
+                    res = PARSING_RES_FAILED;
+                    goto out;
+                }
+                if (decoder->stage == HTTP_CHUNKED_STAGE_LAST_LF) {
+                    decoder->stage = HTTP_CHUNKED_STAGE_DONE;
+                } else if (decoder->stage == HTTP_CHUNKED_STAGE_TRAILER_LF) {
+                    decoder->stage = HTTP_CHUNKED_STAGE_LAST_LINE;
+                } else {
+                    decoder->stage = HTTP_CHUNKED_STAGE_SIZE;
+                }
+                consumed++;
+                break;
+            }
+            default: {
+                assert(false);
+                res = PARSING_RES_FAILED;
+                goto out;
+            }
+        }
+    }
+
+    res = PARSING_RES_SUCCEEDED;
+
+out:
+    *out_consumed    = consumed;
+    *out_decoded_len = decoded_len;
+    return res;
+}
+
+// 
+// Pieces of a message being serialized. A piece that starts right where the previous one ends
+// (e.g. name and value of a header that came from the same buffer) extends it instead.
+// 
+typedef struct {
+    struct iovec* iov;
+    size_t iov_max;
+    size_t iov_len;
+    size_t total_len;
+} iov_writer_t;
+
+static bool write_iov(iov_writer_t* w, string piece) {
+    if (piece.count == 0) {
+        return true;
+    }
+
+    w->total_len += piece.count;
+
+    if (w->iov_len > 0) {
+        struct iovec* last = &w->iov[w->iov_len - 1];
+        if ((const char*) last->iov_base + last->iov_len == piece.data) {
+            last->iov_len += piece.count;
+            return true;
+        }
+    }
+
+    if (w->iov_len >= w->iov_max) {
+        return false;
+    }
+    w->iov[w->iov_len].iov_base = (void*) piece.data;
+    w->iov[w->iov_len].iov_len  = piece.count;
+    w->iov_len++;
+    return true;
+}
+
+static bool write_headers_and_body(iov_writer_t* w, const http_header_t* headers, size_t headers_len,
+                                   const char* body, size_t body_len) {
+    for (size_t i = 0; i < headers_len; i++) {
+        const http_header_t* header = &headers[i];
+        if (!write_iov(w, (string) {header->name, header->name_len}) ||
+            !write_iov(w, STR(": ")) ||
+            !write_iov(w, (string) {header->value, header->value_len}) ||
+            !write_iov(w, STR("\r\n"))) {
+            return false;
+        }
+    }
+
+    return write_iov(w, STR("\r\n")) && write_iov(w, (string) {body, body_len});
+}
+
+http_parsing_result_t http_serialize_response(const http_response_t *resp,
+                                              struct iovec *iov, size_t iov_max,
+                                              char *scratch, size_t scratch_len,
+                                              size_t *out_iov_len, size_t *out_total_len) {
+    assert(resp);
+    assert(iov);
+    assert(scratch || scratch_len == 0);
+    assert(out_iov_len);
+    assert(out_total_len);
+
+    if (resp->status_code < 100 || resp->status_code > 999) {
+        return PARSING_RES_FAILED;
+    }
+
+    // Status code with the spaces around it is the only thing that isn't somewhere already
+    if (scratch_len < HTTP_SERIALIZE_SCRATCH_LEN) {
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    }
+    scratch[0] = ' ';
+    scratch[1] = (char) ('0' + resp->status_code / 100);
+    scratch[2] = (char) ('0' + resp->status_code / 10 % 10);
+    scratch[3] = (char) ('0' + resp->status_code % 10);
+    scratch[4] = ' ';
+
+    string protocol = {resp->protocol, resp->protocol_len};
+    if (protocol.count == 0) {
+        protocol = STR("HTTP/1.1");
+    }
+
+    iov_writer_t w = {iov, iov_max, 0, 0};
+    bool fits = write_iov(&w, protocol) &&
+                write_iov(&w, (string) {scratch, 5}) &&
+                write_iov(&w, (string) {resp->status_text, resp->status_text_len}) &&
+                write_iov(&w, STR("\r\n")) &&
+                write_headers_and_body(&w, resp->headers, resp->headers_len, resp->body, resp->body_len);
+    if (!fits) {
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    }
+
+    *out_iov_len   = w.iov_len;
+    *out_total_len = w.total_len;
+    return PARSING_RES_SUCCEEDED;
+}
+
+http_parsing_result_t http_serialize_request(const http_request_t *req,
+                                             struct iovec *iov, size_t iov_max,
+                                             size_t *out_iov_len, size_t *out_total_len) {
+    assert(req);
+    assert(iov);
+    assert(out_iov_len);
+    assert(out_total_len);
+
+    if (req->method_len == 0 || req->target_len == 0) {
+        return PARSING_RES_FAILED;
+    }
+
+    string protocol = {req->protocol, req->protocol_len};
+    if (protocol.count == 0) {
+        protocol = STR("HTTP/1.1");
+    }
+
+    iov_writer_t w = {iov, iov_max, 0, 0};
+    bool fits = write_iov(&w, (string) {req->method, req->method_len}) &&
+                write_iov(&w, STR(" ")) &&
+                write_iov(&w, (string) {req->target, req->target_len}) &&
+                write_iov(&w, STR(" ")) &&
+                write_iov(&w, protocol) &&
+                write_iov(&w, STR("\r\n")) &&
+                write_headers_and_body(&w, req->headers, req->headers_len, req->body, req->body_len);
+    if (!fits) {
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    }
+
+    *out_iov_len   = w.iov_len;
+    *out_total_len = w.total_len;
+    return PARSING_RES_SUCCEEDED;
+}
+
+void http_rewrite_init(http_rewrite_t *rw, http_rewrite_edit_t *edits, size_t edits_max, char *buf, size_t buf_len) {
+    assert(rw);
+    assert(edits || edits_max == 0);
+    assert(buf || buf_len == 0);
+
+    *rw = (http_rewrite_t) {0};
+    rw->edits     = edits;
+    rw->edits_max = edits_max;
+    rw->buf       = buf;
+    rw->buf_len   = buf_len;
+}
+
+http_parsing_result_t http_rewrite_add_edit(http_rewrite_t *rw, http_rewrite_op_t op,
+                                            const char *name_data, size_t name_len,
+                                            const char *value_data, size_t value_len) {
+    assert(rw);
+    assert(name_data);
+    assert(value_data || op == HTTP_REWRITE_REMOVE);
+
+    string name = {name_data, name_len};
+    if (name.count == 0 || index_of_non_token(name) != name.count) {
+        return PARSING_RES_FAILED;
+    }
+
+    if (rw->edits_len >= rw->edits_max || rw->edits_len >= HTTP_REWRITE_MAX_EDITS) {
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    }
+
+    http_rewrite_edit_t edit = {op, name.data, name.count, header_id(name), NULL, 0};
+
+    if (op != HTTP_REWRITE_REMOVE) {
+        // An empty value wouldn't parse again with this parser
+        string value = {value_data, value_len};
+        if (value.count == 0 || index_of_control(value) != value.count) {
+            return PARSING_RES_FAILED;
+        }
+
+        size_t line_len = name.count + 2 + value.count + 2;
+        if (line_len > rw->buf_len - rw->buf_used) {
+            return PARSING_RES_NOT_ENOUGH_MEMORY;
+        }
+
+        char* line = rw->buf + rw->buf_used;
+        memcpy(line, name.data, name.count);
+        memcpy(line + name.count, ": ", 2);
+        memcpy(line + name.count + 2, value.data, value.count);
+        memcpy(line + line_len - 2, "\r\n", 2);
+
+        edit.line     = line;
+        edit.line_len = line_len;
+        rw->buf_used += line_len;
+    }
+
+    rw->edits[rw->edits_len++] = edit;
+    return PARSING_RES_SUCCEEDED;
+}
+
+// 
+// Walks the headers and only looks for the end of lines that change. Everything between them,
+// from the start line to the blank line, is written as whole spans of the original buffer.
+// 
+static http_parsing_result_t rewrite_message(const http_rewrite_t* rw, const char* start,
+                                             const http_header_t* headers, size_t headers_len,
+                                             const char* body, size_t body_len,
+                                             struct iovec* iov, size_t iov_max,
+                                             size_t* out_iov_len, size_t* out_total_len) {
+    // The blank line is right before the body, "\n" or "\r\n"
+    assert(start && body && body - start >= 2 && body[-1] == '\n');
+    const char* head_end = body[-2] == '\r' ? body - 2 : body - 1;
+
+    // Bit per edit, set once a replacement has found its header
+    uint64_t replaced = 0;
+
+    iov_writer_t w = {iov, iov_max, 0, 0};
+    const char* unchanged = start;
+    for (size_t i = 0; i < headers_len; i++) {
+        const http_header_t* header = &headers[i];
+
+        const http_rewrite_edit_t* edit = NULL;
+        size_t j = 0;
+        for (; j < rw->edits_len; j++) {
+            if (rw->edits[j].op != HTTP_REWRITE_ADD &&
+                header_has_name(header, (string) {rw->edits[j].name, rw->edits[j].name_len}, rw->edits[j].id)) {
+                edit = &rw->edits[j];
+                break;
+            }
+        }
+        if (!edit) {
+            continue;
+        }
+
+        if (!write_iov(&w, (string) {unchanged, (size_t) (header->name - unchanged)})) {
+            return PARSING_RES_NOT_ENOUGH_MEMORY;
+        }
+        if (edit->op == HTTP_REWRITE_REPLACE && !(replaced & ((uint64_t) 1 << j))) {
+            replaced |= (uint64_t) 1 << j;
+            if (!write_iov(&w, (string) {edit->line, edit->line_len})) {
+                return PARSING_RES_NOT_ENOUGH_MEMORY;
+            }
+        }
+
+        // Next span starts after the line ending of this header
+        string rest = {header->name, (size_t) (head_end - header->name)};
+        unchanged = header->name + index_of_char(rest, '\n') + 1;
+    }
+
+    if (!write_iov(&w, (string) {unchanged, (size_t) (head_end - unchanged)})) {
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    }
+
+    for (size_t j = 0; j < rw->edits_len; j++) {
+        const http_rewrite_edit_t* edit = &rw->edits[j];
+        bool appended = edit->op == HTTP_REWRITE_ADD || (edit->op == HTTP_REWRITE_REPLACE && !(replaced & ((uint64_t) 1 << j)));
+        if (appended && !write_iov(&w, (string) {edit->line, edit->line_len})) {
+            return PARSING_RES_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    if (!write_iov(&w, (string) {head_end, (size_t) (body - head_end)}) ||
+        !write_iov(&w, (string) {body, body_len})) {
+        return PARSING_RES_NOT_ENOUGH_MEMORY;
+    }
+
+    *out_iov_len   = w.iov_len;
+    *out_total_len = w.total_len;
+    return PARSING_RES_SUCCEEDED;
+}
+
+http_parsing_result_t http_rewrite_request(const http_rewrite_t *rw, const http_request_t *req,
+                                           struct iovec *iov, size_t iov_max,
+                                           size_t *out_iov_len, size_t *out_total_len) {
+    assert(rw);
+    assert(req);
+    assert(iov);
+    assert(out_iov_len);
+    assert(out_total_len);
+
+    return rewrite_message(rw, req->method, req->headers, req->headers_len, req->body, req->body_len,
+                           iov, iov_max, out_iov_len, out_total_len);
+}
+
+http_parsing_result_t http_rewrite_response(const http_rewrite_t *rw, const http_response_t *resp,
+                                            struct iovec *iov, size_t iov_max,
+                                            size_t *out_iov_len, size_t *out_total_len) {
+    assert(rw);
+    assert(resp);
+    assert(iov);
+    assert(out_iov_len);
+    assert(out_total_len);
+
+    return rewrite_message(rw, resp->protocol, resp->headers, resp->headers_len, resp->body, resp->body_len,
+                           iov, iov_max, out_iov_len, out_total_len);
+}
+
+static bool is_scheme_char(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || is_numeric(ch) || ch == '+' || ch == '-' || ch == '.';
+}
+
+// Length of "scheme:" at the start of target (RFC 3986 section 3.1), 0 if there's none
+static size_t scheme_prefix_len(string target) {
+    if (target.count == 0 || !((target.data[0] >= 'a' && target.data[0] <= 'z') || (target.data[0] >= 'A' && target.data[0] <= 'Z'))) {
+        return 0;
+    }
+    for (size_t i = 1; i < target.count; i++) {
+        if (target.data[i] == ':') {
+            return i + 1;
+        }
+        if (!is_scheme_char(target.data[i])) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Splits off "?query" and "#fragment" from the end of target, what's before them is the path
+static void split_path(string rest, http_target_t* out) {
+    size_t fragment = index_of_char(rest, '#');
+    if (fragment < rest.count) {
+        out->fragment     = rest.data + fragment + 1;
+        out->fragment_len = rest.count - fragment - 1;
+        rest.count = fragment;
+    }
+
+    size_t query = index_of_char(rest, '?');
+    if (query < rest.count) {
+        out->query     = rest.data + query + 1;
+        out->query_len = rest.count - query - 1;
+        rest.count = query;
+    }
+
+    out->path     = rest.data;
+    out->path_len = rest.count;
+}
+
+http_parsing_result_t http_parse_target(const char *target_data, size_t target_len, http_target_t *out_target) {
+    assert(target_data || target_len == 0);
+    assert(out_target);
+
+    *out_target = (http_target_t) {0};
+
+    string target = {target_data, target_len};
+    if (target.count == 0) {
+        return PARSING_RES_FAILED;
+    }
+
+    if (target.data[0] == '/') {
+        out_target->form = HTTP_TARGET_ORIGIN;
+        split_path(target, out_target);
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    if (target.count == 1 && target.data[0] == '*') {
+        out_target->form     = HTTP_TARGET_ASTERISK;
+        out_target->path     = target.data;
+        out_target->path_len = 1;
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    size_t scheme_len = scheme_prefix_len(target);
+    if (scheme_len > 0 && starts_with((string) {target.data + scheme_len, target.count - scheme_len}, STR("//"))) {
+        out_target->form       = HTTP_TARGET_ABSOLUTE;
+        out_target->scheme     = target.data;
+        out_target->scheme_len = scheme_len - 1;
+
+        // Authority lasts until the path, query or fragment
+        string rest = {target.data + scheme_len + 2, target.count - scheme_len - 2};
+        size_t authority_len = 0;
+        while (authority_len < rest.count && rest.data[authority_len] != '/' &&
+               rest.data[authority_len] != '?' && rest.data[authority_len] != '#') {
+            authority_len++;
+        }
+        out_target->authority     = rest.data;
+        out_target->authority_len = authority_len;
+
+        split_path((string) {rest.data + authority_len, rest.count - authority_len}, out_target);
+        return PARSING_RES_SUCCEEDED;
+    }
+
+    // host:port of CONNECT
+    size_t colon = index_of_char(target, ':');
+    if (colon == 0 || colon + 1 >= target.count || string_contains_char(target, '/') ||
+        string_contains_char(target, '?') || string_contains_char(target, '#')) {
+        return PARSING_RES_FAILED;
+    }
+    out_target->form          = HTTP_TARGET_AUTHORITY;
+    out_target->authority     = target.data;
+    out_target->authority_len = target.count;
+    return PARSING_RES_SUCCEEDED;
+}
+
+http_parsing_result_t http_percent_decode(char *data, size_t len, bool plus_as_space, size_t *out_len) {
+    assert(data || len == 0);
+    assert(out_len);
+
+    // Runs without escapes are found with the vectorized search and moved as a whole
+    size_t read = 0;
+    size_t written = 0;
+    for (;;) {
+        string rest = {data + read, len - read};
+        size_t run = plus_as_space ? index_of_either_char(rest, '%', '+') : index_of_char(rest, '%');
+
+        if (written != read) {
+            memmove(data + written, data + read, run);
+        }
+        read    += run;
+        written += run;
+        if (read == len) {
+            break;
+        }
+
+        if (data[read] == '+') {
+            data[written++] = ' ';
+            read++;
+            continue;
+        }
+
+        int high = read + 2 < len ? hex_digit_value(data[read + 1]) : -1;
+        int low  = read + 2 < len ? hex_digit_value(data[read + 2]) : -1;
+        if (high < 0 || low < 0) {
+            return PARSING_RES_FAILED;
+        }
+        data[written++] = (char) (high * 16 + low);
+        read += 3;
+    }
+
+    *out_len = written;
+    return PARSING_RES_SUCCEEDED;
+}
+
+void http_query_iter_init(http_query_iter_t *iter, const char *query, size_t query_len) {
+    assert(iter);
+    assert(query || query_len == 0);
+
+    iter->query     = query;
+    iter->query_len = query_len;
+    iter->pos       = 0;
+}
+
+bool http_query_next(http_query_iter_t *iter, http_query_param_t *out_param) {
+    assert(iter);
+    assert(out_param);
+
+    while (iter->pos < iter->query_len) {
+        string rest = {iter->query + iter->pos, iter->query_len - iter->pos};
+        string pair = {rest.data, index_of_char(rest, '&')};
+        iter->pos += pair.count + 1;
+
+        if (pair.count == 0) {
+            // "a=1&&b=2"
+            continue;
+        }
+
+        size_t equals = index_of_char(pair, '=');
+        out_param->key     = pair.data;
+        out_param->key_len = equals;
+        if (equals < pair.count) {
+            out_param->value     = pair.data + equals + 1;
+            out_param->value_len = pair.count - equals - 1;
+        } else {
+            out_param->value     = pair.data + pair.count;
+            out_param->value_len = 0;
+        }
+        return true;
+    }
+    return false;
+}
+
+http_parsing_result_t http_parse_content_length(const char *value, size_t value_len, uint64_t *out_length) {
+    assert(value || value_len == 0);
+    assert(out_length);
+
+    bool done;
+    uint64_t length = string_to_u64((string) {value, value_len}, &done);
+    if (!done) {
+        return PARSING_RES_FAILED;
+    }
+
+    *out_length = length;
+    return PARSING_RES_SUCCEEDED;
+}
+
+static http_parsing_result_t parse_request_lazy(const char *text_data, size_t text_len, http_lazy_request_t *out_req) {
+    string text = {text_data, text_len};
+
+    size_t line_len;
+    http_parsing_result_t res = find_line_end(text, 0, &line_len);
+    if (res != PARSING_RES_SUCCEEDED) {
+        return res;
+    }
+
+    http_request_t req = {0};
+    res = parse_request_line((string) {text.data, line_len}, &req);
+    if (res != PARSING_RES_SUCCEEDED) {
+        // The line is complete, it won't get any better
+        return PARSING_RES_FAILED;
+    }
+
+    out_req->method       = req.method;
+    out_req->method_len   = req.method_len;
+    out_req->target       = req.target;
+    out_req->target_len   = req.target_len;
+    out_req->protocol     = req.protocol;
+    out_req->protocol_len = req.protocol_len;
+
+    // Starting at the '\n' of the request line finds an empty header block too
+    size_t newline = line_len + line_ending_size(text, line_len) - 1;
+    string from_newline = {text.data + newline, text.count - newline};
+    size_t blank_line = newline + http_scan->index_of_blank_line(from_newline.data, from_newline.count);
+    if (blank_line == text.count) {
+        return PARSING_RES_NOT_ENOUGH_DATA;
+    }
+
+    size_t body_offset = blank_line + (text.data[blank_line + 1] == '\r' ? 3 : 2);
+
+    out_req->header_block     = text.data + newline + 1;
+    out_req->header_block_len = blank_line - newline;
+    out_req->body             = text.data + body_offset;
+    out_req->body_len         = text.count - body_offset;
+    return PARSING_RES_SUCCEEDED;
+}
+
+http_parsing_result_t http_parse_request_lazy(const char *text_data, size_t text_len, http_lazy_request_t *out_req) {
+    assert(text_data);
+    assert(out_req);
+
+    *out_req = (http_lazy_request_t) {0};
+
+    // Headers aren't parsed yet, so there are none to report
+    HTTP_PROBE2(request__start, text_len, text_data);
+    http_parsing_result_t res = parse_request_lazy(text_data, text_len, out_req);
+    HTTP_PROBE4(request__done, text_len, 0, (int) res, text_data);
+    return res;
+}
+
+void http_header_iter_init(http_header_iter_t *iter, const char *header_block, size_t header_block_len) {
+    assert(iter);
+    assert(header_block || header_block_len == 0);
+
+    iter->block     = header_block;
+    iter->block_len = header_block_len;
+    iter->pos       = 0;
+}
+
+http_parsing_result_t http_header_iter_next(http_header_iter_t *iter, http_header_t *out_header) {
+    assert(iter);
+    assert(out_header);
+
+    string rest = {iter->block + iter->pos, iter->block_len - iter->pos};
+    if (rest.count == 0) {
+        return PARSING_RES_NOT_ENOUGH_DATA;
+    }
+
+    size_t line_len;
+    http_parsing_result_t res = find_line_end(rest, 0, &line_len);
+    if (res == PARSING_RES_FAILED) {
+        iter->pos = iter->block_len;
+        return PARSING_RES_FAILED;
+    }
+
+    // The last line of a block from http_parse_request_lazy always has a line ending
+    size_t line_size = res == PARSING_RES_SUCCEEDED ? line_len + line_ending_size(rest, line_len) : rest.count;
+
+    string name;
+    string value;
+    if (parse_header_line((string) {rest.data, line_len}, &name, &value) != PARSING_RES_SUCCEEDED) {
+        iter->pos = iter->block_len;
+        return PARSING_RES_FAILED;
+    }
+    iter->pos += line_size;
+
+    out_header->name      = name.data;
+    out_header->name_len  = name.count;
+    out_header->value     = value.data;
+    out_header->value_len = value.count;
+    out_header->id        = header_id(name);
+    return PARSING_RES_SUCCEEDED;
 }
@@ -0,0 +1,43 @@
+#ifndef LIB_HTTP_PROBES_H
+#define LIB_HTTP_PROBES_H
+
+/*
+ * USDT probes (provider http_parser) for tracing with bpftrace or perf, see tools/bpftrace.
+ * They need <sys/sdt.h> (systemtap-sdt-dev), without it or with HTTP_PARSER_NO_PROBES they are compiled out.
+ *
+ * A probe that isn't attached is a single nop, its arguments are only described in an ELF note.
+ *
+ * Probes and arguments:
+ *   request__start, response__start      (text_len, text)
+ *   request__done, response__done        (text_len, headers_len, result, text)
+ *   headers__start                       (offset of the first header line, text)
+ *   headers__done                        (offset after the headers, headers_len, result, text)
+ *   chunked__start                       (body_len)
+ *   chunked__done                        (body_len, decoded_len, result)
+ *
+ * Every request and response parsing function fires the request or response probes once per message it parses,
+ * a resumed parse fires them again for each call. result is an http_parsing_result_t. text is the start of
+ * the message, it pairs the probes of one message when http_parse_requests_multi parses several of them
+ * in turns on the same thread.
+ */
+
+#if !defined(HTTP_PARSER_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HTTP_PARSER_PROBES
+#endif
+#endif
+
+#if defined(HTTP_PARSER_PROBES)
+#define HTTP_PROBE1(name, a)          DTRACE_PROBE1(http_parser, name, a)
+#define HTTP_PROBE2(name, a, b)       DTRACE_PROBE2(http_parser, name, a, b)
+#define HTTP_PROBE3(name, a, b, c)    DTRACE_PROBE3(http_parser, name, a, b, c)
+#define HTTP_PROBE4(name, a, b, c, d) DTRACE_PROBE4(http_parser, name, a, b, c, d)
+#else
+#define HTTP_PROBE1(name, a)          ((void) 0)
+#define HTTP_PROBE2(name, a, b)       ((void) 0)
+#define HTTP_PROBE3(name, a, b, c)    ((void) 0)
+#define HTTP_PROBE4(name, a, b, c, d) ((void) 0)
+#endif
+
+#endif /* LIB_HTTP_PROBES_H */
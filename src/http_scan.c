@@ -0,0 +1,769 @@
+#include "http_scan.h"
+
+#if !defined(HTTP_PARSER_NO_SIMD) && \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define HTTP_SCAN_X86
+#endif
+
+#if defined(HTTP_SCAN_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// 
+// Kernels for higher tiers are compiled for their instruction set regardless of the flags
+// the library is built with. They are only called after checking that the CPU supports them.
+// 
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+const uint8_t http_char_class[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x11, 0x18, 0x10, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x10, 0x18, 0x18, 0x10, 0x18, 0x18, 0x10,
+    0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x1c, 0x1c, 0x1c, 0x1c, 0x1c, 0x1c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
+    0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x10, 0x10, 0x18, 0x18,
+    0x18, 0x1c, 0x1c, 0x1c, 0x1c, 0x1c, 0x1c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
+    0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x10, 0x18, 0x10, 0x18, 0x00,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+};
+
+static bool is_whitespace(char ch) {
+    return http_char_is(ch, HTTP_CHAR_WHITESPACE);
+}
+
+// Scalar
+
+static size_t index_of_char_scalar(const char* data, size_t count, char ch) {
+    for (size_t i = 0; i < count; i++) {
+        if (data[i] == ch) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static size_t index_of_whitespace_class_scalar(const char* data, size_t count, bool want_whitespace) {
+    for (size_t i = 0; i < count; i++) {
+        if (is_whitespace(data[i]) == want_whitespace) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static size_t index_of_either_char_scalar(const char* data, size_t count, char a, char b) {
+    for (size_t i = 0; i < count; i++) {
+        if (data[i] == a || data[i] == b) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static size_t index_of_non_token_scalar(const char* data, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!http_char_is(data[i], HTTP_CHAR_TOKEN)) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static size_t index_of_control_scalar(const char* data, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!http_char_is(data[i], HTTP_CHAR_FIELD)) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static size_t index_of_blank_line_scalar(const char* data, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (data[i] == '\n' && i + 1 < count &&
+            (data[i + 1] == '\n' || (data[i + 1] == '\r' && i + 2 < count && data[i + 2] == '\n'))) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static const http_scan_kernels_t scalar_kernels = {
+    HTTP_PARSER_IMPL_SCALAR,
+    index_of_char_scalar,
+    index_of_whitespace_class_scalar,
+    index_of_either_char_scalar,
+    index_of_non_token_scalar,
+    index_of_control_scalar,
+    index_of_blank_line_scalar,
+};
+
+#if defined(HTTP_SCAN_X86)
+
+static unsigned lowest_set_bit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned) index;
+#else
+    return (unsigned) __builtin_ctz(mask);
+#endif
+}
+
+// SSE2: compare 16 bytes at once, turn the comparison into a bit mask and take its lowest set bit.
+
+TARGET("sse2")
+static size_t index_of_char_sse2(const char* data, size_t count, char ch) {
+    size_t i = 0;
+    __m128i needle = _mm_set1_epi8(ch);
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    return i + index_of_char_scalar(data + i, count - i, ch);
+}
+
+TARGET("sse2")
+static size_t index_of_whitespace_class_sse2(const char* data, size_t count, bool want_whitespace) {
+    // Runs of whitespace are usually a single space, don't bother with vectors for them.
+    if (!want_whitespace && count > 0 && !is_whitespace(data[0])) {
+        return 0;
+    }
+
+    size_t i = 0;
+    __m128i space   = _mm_set1_epi8(' ');
+    __m128i tab     = _mm_set1_epi8('\t');
+    __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                               _mm_cmpeq_epi8(chunk, tab)),
+                                  _mm_cmpeq_epi8(chunk, newline));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(ws);
+        if (!want_whitespace) {
+            mask = ~mask & 0xFFFF;
+        }
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    return i + index_of_whitespace_class_scalar(data + i, count - i, want_whitespace);
+}
+
+TARGET("sse2")
+static size_t index_of_either_char_sse2(const char* data, size_t count, char a, char b) {
+    size_t i = 0;
+    __m128i needle_a = _mm_set1_epi8(a);
+    __m128i needle_b = _mm_set1_epi8(b);
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, needle_a),
+                                                                  _mm_cmpeq_epi8(chunk, needle_b)));
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    return i + index_of_either_char_scalar(data + i, count - i, a, b);
+}
+
+// Control characters are bytes up to 0x1F (unsigned, so obs-text 0x80-0xFF is allowed) and 0x7F
+TARGET("sse2")
+static size_t index_of_control_sse2(const char* data, size_t count) {
+    size_t i = 0;
+    __m128i last_control = _mm_set1_epi8(0x1F);
+    __m128i tab          = _mm_set1_epi8('\t');
+    __m128i del          = _mm_set1_epi8(0x7F);
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, last_control), chunk);
+        control = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(chunk, tab), control), _mm_cmpeq_epi8(chunk, del));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(control);
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    return i + index_of_control_scalar(data + i, count - i);
+}
+
+// The three bytes of a line ending are compared in three loads shifted by one byte
+TARGET("sse2")
+static size_t index_of_blank_line_sse2(const char* data, size_t count) {
+    size_t i = 0;
+    __m128i newline = _mm_set1_epi8('\n');
+    __m128i cr      = _mm_set1_epi8('\r');
+    for (; i + 18 <= count; i += 16) {
+        __m128i first  = _mm_loadu_si128((const __m128i*) (data + i));
+        __m128i second = _mm_loadu_si128((const __m128i*) (data + i + 1));
+        __m128i third  = _mm_loadu_si128((const __m128i*) (data + i + 2));
+        __m128i ending = _mm_or_si128(_mm_cmpeq_epi8(second, newline),
+                                      _mm_and_si128(_mm_cmpeq_epi8(second, cr), _mm_cmpeq_epi8(third, newline)));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, newline), ending));
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    return i + index_of_blank_line_scalar(data + i, count - i);
+}
+
+// Tokens aren't a range or a few characters, SSE2 has nothing better than the table
+static const http_scan_kernels_t sse2_kernels = {
+    HTTP_PARSER_IMPL_SSE2,
+    index_of_char_sse2,
+    index_of_whitespace_class_sse2,
+    index_of_either_char_sse2,
+    index_of_non_token_scalar,
+    index_of_control_sse2,
+    index_of_blank_line_sse2,
+};
+
+// 
+// SSE4.2: a single character is still fastest with SSE2 compares, but character sets
+// are matched with one explicit-length string compare instead of a compare per character.
+// 
+
+TARGET("sse4.2")
+static size_t index_of_whitespace_class_sse42(const char* data, size_t count, bool want_whitespace) {
+    // Runs of whitespace are usually a single space, don't bother with vectors for them.
+    if (!want_whitespace && count > 0 && !is_whitespace(data[0])) {
+        return 0;
+    }
+
+    size_t i = 0;
+    __m128i set = _mm_setr_epi8(' ', '\t', '\n', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+        int index;
+        if (want_whitespace) {
+            index = _mm_cmpestri(set, 3, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        } else {
+            index = _mm_cmpestri(set, 3, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT |
+                                                    _SIDD_MASKED_NEGATIVE_POLARITY);
+        }
+        if (index < 16) {
+            return i + (size_t) index;
+        }
+    }
+    return i + index_of_whitespace_class_scalar(data + i, count - i, want_whitespace);
+}
+
+TARGET("sse4.2")
+static size_t index_of_non_token_sse42(const char* data, size_t count) {
+    // Non-token characters take 10 ranges, but a compare takes 8. The last one includes
+    // '|' and '~', which are tokens, so they are checked again with the table.
+    static const char ranges[16] = "\x00 " "\"\"" "()" ",," "//" ":@" "[]" "{\xff";
+    __m128i set = _mm_loadu_si128((const __m128i*) ranges);
+
+    size_t i = 0;
+    while (i + 16 <= count) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+        int index = _mm_cmpestri(set, 16, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (index == 16) {
+            i += 16;
+        } else if (!http_char_is(data[i + index], HTTP_CHAR_TOKEN)) {
+            return i + (size_t) index;
+        } else {
+            i += (size_t) index + 1;
+        }
+    }
+    return i + index_of_non_token_scalar(data + i, count - i);
+}
+
+TARGET("sse4.2")
+static size_t index_of_control_sse42(const char* data, size_t count) {
+    __m128i set = _mm_setr_epi8(0x00, 0x08, 0x0A, 0x1F, 0x7F, 0x7F, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i));
+        int index = _mm_cmpestri(set, 6, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (index < 16) {
+            return i + (size_t) index;
+        }
+    }
+    return i + index_of_control_scalar(data + i, count - i);
+}
+
+static const http_scan_kernels_t sse42_kernels = {
+    HTTP_PARSER_IMPL_SSE42,
+    index_of_char_sse2,
+    index_of_whitespace_class_sse42,
+    index_of_either_char_sse2,
+    index_of_non_token_sse42,
+    index_of_control_sse42,
+    index_of_blank_line_sse2,
+};
+
+// 
+// With byte shuffles, the token set is looked up by nibbles: the high nibble of a byte picks
+// a group of low nibbles that are tokens with it, a byte is a token if its low nibble is in the group.
+// There are 6 groups, one bit each.
+// 
+static const char token_low_nibbles[16] = {
+    0x3a, 0x3f, 0x3e, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3e, 0x3e, 0x3d, 0x15, 0x34, 0x15, 0x3d, 0x1c,
+};
+static const char token_high_nibbles[16] = {
+    0x00, 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+// 
+// AVX2: same as SSE2 with 32 bytes at once, the tail goes through SSE2. The upper halves of the ymm registers
+// are cleared before that, legacy SSE code stalls on every instruction while they are dirty.
+// 
+
+TARGET("avx2")
+static size_t index_of_char_avx2(const char* data, size_t count, char ch) {
+    size_t i = 0;
+    __m256i needle = _mm256_set1_epi8(ch);
+    for (; i + 32 <= count; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + i));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + index_of_char_sse2(data + i, count - i, ch);
+}
+
+TARGET("avx2")
+static size_t index_of_whitespace_class_avx2(const char* data, size_t count, bool want_whitespace) {
+    // Runs of whitespace are usually a single space, don't bother with vectors for them.
+    if (!want_whitespace && count > 0 && !is_whitespace(data[0])) {
+        return 0;
+    }
+
+    size_t i = 0;
+    __m256i space   = _mm256_set1_epi8(' ');
+    __m256i tab     = _mm256_set1_epi8('\t');
+    __m256i newline = _mm256_set1_epi8('\n');
+    for (; i + 32 <= count; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + i));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                                                     _mm256_cmpeq_epi8(chunk, tab)),
+                                     _mm256_cmpeq_epi8(chunk, newline));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(ws);
+        if (!want_whitespace) {
+            mask = ~mask;
+        }
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + index_of_whitespace_class_sse2(data + i, count - i, want_whitespace);
+}
+
+TARGET("avx2")
+static size_t index_of_either_char_avx2(const char* data, size_t count, char a, char b) {
+    size_t i = 0;
+    __m256i needle_a = _mm256_set1_epi8(a);
+    __m256i needle_b = _mm256_set1_epi8(b);
+    for (; i + 32 <= count; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + i));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, needle_a),
+                                                                        _mm256_cmpeq_epi8(chunk, needle_b)));
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + index_of_either_char_sse2(data + i, count - i, a, b);
+}
+
+TARGET("avx2")
+static size_t index_of_non_token_avx2(const char* data, size_t count) {
+    size_t i = 0;
+    __m256i low_nibbles  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) token_low_nibbles));
+    __m256i high_nibbles = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) token_high_nibbles));
+    __m256i nibble       = _mm256_set1_epi8(0x0F);
+    for (; i + 32 <= count; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + i));
+        __m256i low  = _mm256_shuffle_epi8(low_nibbles, _mm256_and_si256(chunk, nibble));
+        __m256i high = _mm256_shuffle_epi8(high_nibbles, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble));
+        __m256i non_token = _mm256_cmpeq_epi8(_mm256_and_si256(low, high), _mm256_setzero_si256());
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(non_token);
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + index_of_non_token_sse42(data + i, count - i);
+}
+
+TARGET("avx2")
+static size_t index_of_control_avx2(const char* data, size_t count) {
+    size_t i = 0;
+    __m256i last_control = _mm256_set1_epi8(0x1F);
+    __m256i tab          = _mm256_set1_epi8('\t');
+    __m256i del          = _mm256_set1_epi8(0x7F);
+    for (; i + 32 <= count; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (data + i));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, last_control), chunk);
+        control = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, tab), control),
+                                  _mm256_cmpeq_epi8(chunk, del));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(control);
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + index_of_control_sse2(data + i, count - i);
+}
+
+TARGET("avx2")
+static size_t index_of_blank_line_avx2(const char* data, size_t count) {
+    size_t i = 0;
+    __m256i newline = _mm256_set1_epi8('\n');
+    __m256i cr      = _mm256_set1_epi8('\r');
+    for (; i + 34 <= count; i += 32) {
+        __m256i first  = _mm256_loadu_si256((const __m256i*) (data + i));
+        __m256i second = _mm256_loadu_si256((const __m256i*) (data + i + 1));
+        __m256i third  = _mm256_loadu_si256((const __m256i*) (data + i + 2));
+        __m256i ending = _mm256_or_si256(_mm256_cmpeq_epi8(second, newline),
+                                         _mm256_and_si256(_mm256_cmpeq_epi8(second, cr), _mm256_cmpeq_epi8(third, newline)));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, newline), ending));
+        if (mask) {
+            return i + lowest_set_bit(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + index_of_blank_line_sse2(data + i, count - i);
+}
+
+static const http_scan_kernels_t avx2_kernels = {
+    HTTP_PARSER_IMPL_AVX2,
+    index_of_char_avx2,
+    index_of_whitespace_class_avx2,
+    index_of_either_char_avx2,
+    index_of_non_token_avx2,
+    index_of_control_avx2,
+    index_of_blank_line_avx2,
+};
+
+// 
+// AVX-512: compares produce a bit mask directly. The tail is read with a masked load,
+// which doesn't touch bytes past the end, so there is no scalar loop at all.
+// 
+
+#if !defined(_MSC_VER) || defined(__clang__) || (_MSC_VER >= 1920 && defined(_M_X64))
+
+static uint64_t tail_mask(size_t remaining) {
+    return remaining >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << remaining) - 1;
+}
+
+static unsigned lowest_set_bit64(uint64_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (unsigned) index;
+#else
+    return (unsigned) __builtin_ctzll(mask);
+#endif
+}
+
+TARGET("avx512f,avx512bw")
+static size_t index_of_char_avx512(const char* data, size_t count, char ch) {
+    __m512i needle = _mm512_set1_epi8(ch);
+    for (size_t i = 0; i < count; i += 64) {
+        __mmask64 load = tail_mask(count - i);
+        __m512i chunk = _mm512_maskz_loadu_epi8(load, data + i);
+        uint64_t mask = _mm512_mask_cmpeq_epi8_mask(load, chunk, needle);
+        if (mask) {
+            return i + lowest_set_bit64(mask);
+        }
+    }
+    return count;
+}
+
+TARGET("avx512f,avx512bw")
+static size_t index_of_whitespace_class_avx512(const char* data, size_t count, bool want_whitespace) {
+    // Runs of whitespace are usually a single space, don't bother with vectors for them.
+    if (!want_whitespace && count > 0 && !is_whitespace(data[0])) {
+        return 0;
+    }
+
+    __m512i space   = _mm512_set1_epi8(' ');
+    __m512i tab     = _mm512_set1_epi8('\t');
+    __m512i newline = _mm512_set1_epi8('\n');
+    for (size_t i = 0; i < count; i += 64) {
+        __mmask64 load = tail_mask(count - i);
+        __m512i chunk = _mm512_maskz_loadu_epi8(load, data + i);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(chunk, space) |
+                        _mm512_cmpeq_epi8_mask(chunk, tab) |
+                        _mm512_cmpeq_epi8_mask(chunk, newline);
+        if (!want_whitespace) {
+            mask = ~mask;
+        }
+        mask &= load;
+        if (mask) {
+            return i + lowest_set_bit64(mask);
+        }
+    }
+    return count;
+}
+
+TARGET("avx512f,avx512bw")
+static size_t index_of_either_char_avx512(const char* data, size_t count, char a, char b) {
+    __m512i needle_a = _mm512_set1_epi8(a);
+    __m512i needle_b = _mm512_set1_epi8(b);
+    for (size_t i = 0; i < count; i += 64) {
+        __mmask64 load = tail_mask(count - i);
+        __m512i chunk = _mm512_maskz_loadu_epi8(load, data + i);
+        uint64_t mask = _mm512_mask_cmpeq_epi8_mask(load, chunk, needle_a) |
+                        _mm512_mask_cmpeq_epi8_mask(load, chunk, needle_b);
+        if (mask) {
+            return i + lowest_set_bit64(mask);
+        }
+    }
+    return count;
+}
+
+TARGET("avx512f,avx512bw")
+static size_t index_of_non_token_avx512(const char* data, size_t count) {
+    __m512i low_nibbles  = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) token_low_nibbles));
+    __m512i high_nibbles = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) token_high_nibbles));
+    __m512i nibble       = _mm512_set1_epi8(0x0F);
+    for (size_t i = 0; i < count; i += 64) {
+        __mmask64 load = tail_mask(count - i);
+        __m512i chunk = _mm512_maskz_loadu_epi8(load, data + i);
+        __m512i low  = _mm512_shuffle_epi8(low_nibbles, _mm512_and_si512(chunk, nibble));
+        __m512i high = _mm512_shuffle_epi8(high_nibbles, _mm512_and_si512(_mm512_srli_epi16(chunk, 4), nibble));
+        uint64_t mask = _mm512_mask_testn_epi8_mask(load, low, high);
+        if (mask) {
+            return i + lowest_set_bit64(mask);
+        }
+    }
+    return count;
+}
+
+TARGET("avx512f,avx512bw")
+static size_t index_of_control_avx512(const char* data, size_t count) {
+    __m512i first_printable = _mm512_set1_epi8(0x20);
+    __m512i tab             = _mm512_set1_epi8('\t');
+    __m512i del             = _mm512_set1_epi8(0x7F);
+    for (size_t i = 0; i < count; i += 64) {
+        __mmask64 load = tail_mask(count - i);
+        __m512i chunk = _mm512_maskz_loadu_epi8(load, data + i);
+        uint64_t mask = (_mm512_cmplt_epu8_mask(chunk, first_printable) & ~_mm512_cmpeq_epi8_mask(chunk, tab)) |
+                        _mm512_cmpeq_epi8_mask(chunk, del);
+        mask &= load;
+        if (mask) {
+            return i + lowest_set_bit64(mask);
+        }
+    }
+    return count;
+}
+
+// Bytes past the end are loaded as zeros, which match nothing
+TARGET("avx512f,avx512bw")
+static size_t index_of_blank_line_avx512(const char* data, size_t count) {
+    __m512i newline = _mm512_set1_epi8('\n');
+    __m512i cr      = _mm512_set1_epi8('\r');
+    for (size_t i = 0; i < count; i += 64) {
+        __m512i first  = _mm512_maskz_loadu_epi8(tail_mask(count - i), data + i);
+        __m512i second = _mm512_maskz_loadu_epi8(tail_mask(count - i - 1), data + i + 1);
+        __m512i third  = _mm512_maskz_loadu_epi8(count - i >= 2 ? tail_mask(count - i - 2) : 0, data + i + 2);
+        uint64_t mask = _mm512_cmpeq_epi8_mask(first, newline) &
+                        (_mm512_cmpeq_epi8_mask(second, newline) |
+                         (_mm512_cmpeq_epi8_mask(second, cr) & _mm512_cmpeq_epi8_mask(third, newline)));
+        if (mask) {
+            return i + lowest_set_bit64(mask);
+        }
+    }
+    return count;
+}
+
+static const http_scan_kernels_t avx512_kernels = {
+    HTTP_PARSER_IMPL_AVX512,
+    index_of_char_avx512,
+    index_of_whitespace_class_avx512,
+    index_of_either_char_avx512,
+    index_of_non_token_avx512,
+    index_of_control_avx512,
+    index_of_blank_line_avx512,
+};
+
+#define HTTP_SCAN_AVX512
+
+#endif
+
+#endif /* HTTP_SCAN_X86 */
+
+// Dispatch
+
+static bool cpu_supports(http_parser_impl_t impl) {
+    switch (impl) {
+        case HTTP_PARSER_IMPL_AUTO:
+        case HTTP_PARSER_IMPL_SCALAR:
+            return true;
+
+#if defined(HTTP_SCAN_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+        case HTTP_PARSER_IMPL_SSE2: {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[3] >> 26) & 1;
+        }
+        case HTTP_PARSER_IMPL_SSE42: {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] >> 20) & 1;
+        }
+        case HTTP_PARSER_IMPL_AVX2: {
+            int info[4];
+            __cpuid(info, 1);
+            bool os_saves_ymm = ((info[2] >> 27) & 1) && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            return os_saves_ymm && ((info[1] >> 5) & 1);
+        }
+        case HTTP_PARSER_IMPL_AVX512: {
+            int info[4];
+            __cpuid(info, 1);
+            bool os_saves_zmm = ((info[2] >> 27) & 1) && (_xgetbv(0) & 0xE6) == 0xE6;
+            __cpuidex(info, 7, 0);
+            return os_saves_zmm && ((info[1] >> 16) & 1) && ((info[1] >> 30) & 1);
+        }
+#else
+        case HTTP_PARSER_IMPL_SSE2:   return __builtin_cpu_supports("sse2");
+        case HTTP_PARSER_IMPL_SSE42:  return __builtin_cpu_supports("sse4.2");
+        case HTTP_PARSER_IMPL_AVX2:   return __builtin_cpu_supports("avx2");
+#if defined(HTTP_SCAN_AVX512)
+        case HTTP_PARSER_IMPL_AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+#endif
+#endif
+
+        default:
+            return false;
+    }
+}
+
+static const http_scan_kernels_t* kernels_for(http_parser_impl_t impl) {
+    switch (impl) {
+#if defined(HTTP_SCAN_X86)
+        case HTTP_PARSER_IMPL_SSE2:   return &sse2_kernels;
+        case HTTP_PARSER_IMPL_SSE42:  return &sse42_kernels;
+        case HTTP_PARSER_IMPL_AVX2:   return &avx2_kernels;
+#if defined(HTTP_SCAN_AVX512)
+        case HTTP_PARSER_IMPL_AVX512: return &avx512_kernels;
+#endif
+#endif
+        default:                      return &scalar_kernels;
+    }
+}
+
+static const http_scan_kernels_t* select_best_kernels(void) {
+    static const http_parser_impl_t tiers[] = {
+        HTTP_PARSER_IMPL_AVX512,
+        HTTP_PARSER_IMPL_AVX2,
+        HTTP_PARSER_IMPL_SSE42,
+        HTTP_PARSER_IMPL_SSE2,
+    };
+    for (size_t i = 0; i < sizeof(tiers) / sizeof(tiers[0]); i++) {
+        if (http_parser_impl_supported(tiers[i])) {
+            return kernels_for(tiers[i]);
+        }
+    }
+    return &scalar_kernels;
+}
+
+// 
+// Until the first call picks the kernels, http_scan points to these, which pick them and
+// forward the call. With GCC and Clang that happens at startup, before main.
+// 
+
+static size_t index_of_char_select(const char* data, size_t count, char ch) {
+    http_scan = select_best_kernels();
+    return http_scan->index_of_char(data, count, ch);
+}
+
+static size_t index_of_whitespace_class_select(const char* data, size_t count, bool want_whitespace) {
+    http_scan = select_best_kernels();
+    return http_scan->index_of_whitespace_class(data, count, want_whitespace);
+}
+
+static size_t index_of_either_char_select(const char* data, size_t count, char a, char b) {
+    http_scan = select_best_kernels();
+    return http_scan->index_of_either_char(data, count, a, b);
+}
+
+static size_t index_of_non_token_select(const char* data, size_t count) {
+    http_scan = select_best_kernels();
+    return http_scan->index_of_non_token(data, count);
+}
+
+static size_t index_of_control_select(const char* data, size_t count) {
+    http_scan = select_best_kernels();
+    return http_scan->index_of_control(data, count);
+}
+
+static size_t index_of_blank_line_select(const char* data, size_t count) {
+    http_scan = select_best_kernels();
+    return http_scan->index_of_blank_line(data, count);
+}
+
+static const http_scan_kernels_t select_kernels = {
+    HTTP_PARSER_IMPL_AUTO,
+    index_of_char_select,
+    index_of_whitespace_class_select,
+    index_of_either_char_select,
+    index_of_non_token_select,
+    index_of_control_select,
+    index_of_blank_line_select,
+};
+
+const http_scan_kernels_t *http_scan = &select_kernels;
+
+#if defined(__GNUC__)
+__attribute__((constructor))
+static void init_scan_kernels(void) {
+    __builtin_cpu_init();
+    http_scan = select_best_kernels();
+}
+#endif
+
+bool http_parser_impl_supported(http_parser_impl_t impl) {
+    if (impl != HTTP_PARSER_IMPL_AUTO && impl != HTTP_PARSER_IMPL_SCALAR &&
+        kernels_for(impl) == &scalar_kernels) {
+        // Not compiled in
+        return false;
+    }
+    return cpu_supports(impl);
+}
+
+bool http_parser_set_impl(http_parser_impl_t impl) {
+    if (!http_parser_impl_supported(impl)) {
+        return false;
+    }
+
+    if (impl == HTTP_PARSER_IMPL_AUTO) {
+        http_scan = select_best_kernels();
+    } else {
+        http_scan = kernels_for(impl);
+    }
+    return true;
+}
+
+http_parser_impl_t http_parser_get_impl(void) {
+    if (http_scan == &select_kernels) {
+        http_scan = select_best_kernels();
+    }
+    return http_scan->impl;
+}
@@ -0,0 +1,50 @@
+#ifndef LIB_HTTP_SCAN_H
+#define LIB_HTTP_SCAN_H
+
+#include "http_parser.h"
+
+/*
+ * Scanning kernels. Every hot loop of the parser is a search for the first byte that is
+ * (or isn't) in some small set. There is a version of each kernel for every instruction set tier,
+ * the best one supported by the CPU is picked on first use (or forced with http_parser_set_impl).
+ *
+ * All kernels return count if there's no such byte.
+ */
+typedef struct {
+    http_parser_impl_t impl;
+
+    size_t (*index_of_char)(const char *data, size_t count, char ch);
+
+    /* Whitespace is ' ', '\t' and '\n'. */
+    size_t (*index_of_whitespace_class)(const char *data, size_t count, bool want_whitespace);
+
+    size_t (*index_of_either_char)(const char *data, size_t count, char a, char b);
+
+    /* First byte that isn't a token character (RFC 9110 section 5.6.2), e.g. the ':' after a header name. */
+    size_t (*index_of_non_token)(const char *data, size_t count);
+
+    /* First control character other than '\t', which are all invalid in lines except for '\r' and '\n' ending them. */
+    size_t (*index_of_control)(const char *data, size_t count);
+
+    /* First '\n' that is followed by "\n" or "\r\n", where a header block ends. */
+    size_t (*index_of_blank_line)(const char *data, size_t count);
+} http_scan_kernels_t;
+
+extern const http_scan_kernels_t *http_scan;
+
+/*
+ * Classes of every byte, for checking single characters with one lookup.
+ */
+#define HTTP_CHAR_WHITESPACE 0x01 /* ' ', '\t' and '\n', as for index_of_whitespace_class */
+#define HTTP_CHAR_DIGIT      0x02
+#define HTTP_CHAR_HEX        0x04
+#define HTTP_CHAR_TOKEN      0x08
+#define HTTP_CHAR_FIELD      0x10 /* allowed in field values and start lines: not a control character, or '\t' */
+
+extern const uint8_t http_char_class[256];
+
+static inline bool http_char_is(char ch, uint8_t char_class) {
+    return (http_char_class[(unsigned char) ch] & char_class) != 0;
+}
+
+#endif /* LIB_HTTP_SCAN_H */
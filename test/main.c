@@ -516,6 +516,192 @@ static void test_request_incomplete_protocol_with_body() {
     my_assert(result == PARSING_RES_FAILED);
 }
 
+static void test_request_long_lines() {
+    // Long enough for every scanning loop to go through whole vectors before the tail
+    char text[] =
+        "GET    /some/rather/long/path/that/goes/on/and/on?with=a&query=string        HTTP/1.1\n"
+        "X-Very-Long-Header-Name-That-Spans-More-Than-One-Vector:      \t   value with spaces, tabs\tand, commas, that is also quite long\n"
+        "Host: localhost\n"
+        "\n";
+
+    http_header_t headers_buf[100];
+    http_request_t request;
+    http_parsing_result_t result = http_parse_request(text, sizeof(text) - 1,
+                                                      headers_buf, ARRAY_LENGTH(headers_buf),
+                                                      &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){request.method, request.method_len}, STR("GET")));
+    my_assert(strings_match((string){request.target, request.target_len}, STR("/some/rather/long/path/that/goes/on/and/on?with=a&query=string")));
+    my_assert(strings_match((string){request.protocol, request.protocol_len}, STR("HTTP/1.1")));
+    my_assert(request.headers_len == 2);
+    my_assert(strings_match((string){request.headers[0].name, request.headers[0].name_len}, STR("X-Very-Long-Header-Name-That-Spans-More-Than-One-Vector")));
+    my_assert(strings_match((string){request.headers[0].value, request.headers[0].value_len}, STR("value with spaces, tabs\tand, commas, that is also quite long")));
+    my_assert(strings_match((string){request.headers[1].value, request.headers[1].value_len}, STR("localhost")));
+}
+
+static void test_header_ids() {
+    char text[] =
+        "GET / HTTP/1.1\n"
+        "host: localhost\n"
+        "CONTENT-LENGTH: 0\n"
+        "Sec-Fetch-Mode: cors\n"
+        "Sec-Fetch-Site: none\n"
+        "X-Custom: 1\n"
+        "Hos: typo\n"
+        "\n";
+
+    http_header_t headers_buf[100];
+    http_request_t request;
+    http_parsing_result_t result = http_parse_request(text, sizeof(text) - 1,
+                                                      headers_buf, ARRAY_LENGTH(headers_buf),
+                                                      &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(request.headers_len == 6);
+    my_assert(request.headers[0].id == HTTP_HEADER_HOST);
+    my_assert(request.headers[1].id == HTTP_HEADER_CONTENT_LENGTH);
+    my_assert(request.headers[2].id == HTTP_HEADER_SEC_FETCH_MODE);
+    my_assert(request.headers[3].id == HTTP_HEADER_SEC_FETCH_SITE);
+    my_assert(request.headers[4].id == HTTP_HEADER_UNKNOWN);
+    my_assert(request.headers[5].id == HTTP_HEADER_UNKNOWN);
+
+    // Every well-known name maps back to itself
+    for (size_t id = HTTP_HEADER_UNKNOWN + 1; id < HTTP_HEADER_COUNT; id++) {
+        const char* name = http_header_id_name((http_header_id_t) id);
+        my_assert(http_header_id_lookup(name, strlen(name)) == (http_header_id_t) id);
+    }
+    my_assert(http_header_id_lookup("WWW-AUTHENTICATE", strlen("WWW-AUTHENTICATE")) == HTTP_HEADER_WWW_AUTHENTICATE);
+    my_assert(http_header_id_lookup("", 0) == HTTP_HEADER_UNKNOWN);
+    my_assert(strcmp(http_header_id_name(HTTP_HEADER_ETAG), "ETag") == 0);
+}
+
+static void test_find_header_indexed() {
+    char text[] =
+        "GET / HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "X-Trace: a\r\n"
+        "Accept: */*\r\n"
+        "x-trace: b\r\n"
+        "Cookie: one=1\r\n"
+        "Cookie: two=2\r\n"
+        "\r\n";
+
+    uint32_t slots[16];
+    http_header_index_t index;
+    http_header_index_init(&index, slots, ARRAY_LENGTH(slots));
+
+    http_header_t headers_buf[100];
+    http_request_t request;
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+    state.index = &index;
+
+    http_parsing_result_t result = http_parse_request_continue(&state, text, sizeof(text) - 1,
+                                                               headers_buf, ARRAY_LENGTH(headers_buf),
+                                                               &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(request.header_index == &index);
+    my_assert(index.count == 6);
+
+    const http_header_t* host = http_find_header(&request, "HOST", 4);
+    my_assert(host == &request.headers[0]);
+    my_assert(http_find_header(&request, "Content-Length", strlen("Content-Length")) == NULL);
+    my_assert(http_find_header(&request, "X-Missing", strlen("X-Missing")) == NULL);
+
+    // All headers with the same name, known and unknown ones, in order
+    http_header_find_iter_t iter;
+    http_find_all_headers(&request, "X-TRACE", strlen("X-TRACE"), &iter);
+    my_assert(http_find_next_header(&iter) == &request.headers[1]);
+    my_assert(http_find_next_header(&iter) == &request.headers[3]);
+    my_assert(http_find_next_header(&iter) == NULL);
+
+    http_find_all_headers(&request, "cookie", strlen("cookie"), &iter);
+    my_assert(http_find_next_header(&iter) == &request.headers[4]);
+    my_assert(http_find_next_header(&iter) == &request.headers[5]);
+    my_assert(http_find_next_header(&iter) == NULL);
+}
+
+static void test_find_header_not_indexed() {
+    char text[] =
+        "HTTP/1.1 200 OK\n"
+        "Set-Cookie: a=1\n"
+        "Server: test\n"
+        "Set-Cookie: b=2\n"
+        "\n";
+
+    http_header_t headers_buf[100];
+    http_response_t response;
+    http_parsing_result_t result = http_parse_response(text, sizeof(text) - 1,
+                                                       headers_buf, ARRAY_LENGTH(headers_buf),
+                                                       &response);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(response.header_index == NULL);
+
+    http_header_find_iter_t iter;
+    http_find_all_response_headers(&response, "set-cookie", strlen("set-cookie"), &iter);
+    my_assert(http_find_next_header(&iter) == &response.headers[0]);
+    my_assert(http_find_next_header(&iter) == &response.headers[2]);
+    my_assert(http_find_next_header(&iter) == NULL);
+
+    // Index that is too small falls back to the same scan
+    uint32_t slots[2];
+    http_header_index_t index;
+    http_header_index_init(&index, slots, ARRAY_LENGTH(slots));
+
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+    state.index = &index;
+
+    result = http_parse_response_continue(&state, text, sizeof(text) - 1,
+                                          headers_buf, ARRAY_LENGTH(headers_buf),
+                                          &response);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(index.overflowed);
+    my_assert(http_find_response_header(&response, "Server", 6) == &response.headers[1]);
+}
+
+static void test_find_header_small_index() {
+    char text[] =
+        "GET / HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Accept: */*\r\n"
+        "\r\n";
+
+    // Lookups of missing names end, however few slots there are
+    for (size_t slots_len = 1; slots_len <= 4; slots_len *= 2) {
+        uint32_t slots[4];
+        http_header_index_t index;
+        http_header_index_init(&index, slots, slots_len);
+
+        http_header_t headers_buf[10];
+        http_request_t request;
+        http_parser_state_t state;
+        http_parser_state_init(&state);
+        state.index = &index;
+
+        http_parsing_result_t result = http_parse_request_continue(&state, text, sizeof(text) - 1,
+                                                                   headers_buf, ARRAY_LENGTH(headers_buf),
+                                                                   &request);
+        my_assert(result == PARSING_RES_SUCCEEDED);
+        my_assert(index.count < slots_len);
+        my_assert(http_find_header(&request, "X-Missing", strlen("X-Missing")) == NULL);
+        my_assert(http_find_header(&request, "Accept", strlen("Accept")) == &request.headers[1]);
+    }
+
+    // Even an index that has no empty slot (not built by the parser) isn't probed forever
+    http_header_t headers[] = {
+        {"A", 1, "1", 1, HTTP_HEADER_UNKNOWN},
+        {"B", 1, "2", 1, HTTP_HEADER_UNKNOWN},
+    };
+    uint32_t slots[2] = {0xFFFF0001u, 0xFFFF0002u};
+    http_header_index_t index = {slots, ARRAY_LENGTH(slots), 2, false};
+
+    http_request_t request = {0};
+    request.headers      = headers;
+    request.headers_len  = ARRAY_LENGTH(headers);
+    request.header_index = &index;
+    my_assert(http_find_header(&request, "C", 1) == NULL);
+}
+
 static void test_decode() {
     char text[] = 
         "HTTP/1.1 200 OK\n"
@@ -655,37 +841,1676 @@ static void test_decode_last_line_invalid() {
     }
 }
 
-int main(int argc, char* argv[]) {
-    test_response_full();
-    test_response_invalid_protocol();
-    test_response_invalid_status_code();
-    test_response_custom_status_text();
-    test_response_header_with_newline();
-    test_response_header_no_newline();
-    test_response_incomplete_header();
-    test_response_incomplete_header_with_body();
-    test_response_no_headers();
-    test_response_only_status_line();
-    test_response_only_incomplete_protocol();
-    test_response_incomplete_protocol_with_space();
-    test_response_incomplete_protocol_with_body();
+static void test_decode_in_place() {
+    char text[] =
+        "7\r\n"
+        "Mozilla\r\n"
+        "11\r\n"
+        "Developer Network\r\n"
+        "0\r\n"
+        "\r\n";
 
-    test_request_full();
-    test_request_full_with_incomplete_protocol();
-    test_request_header_with_newline();
-    test_request_header_no_newline();
-    test_request_incomplete_header();
-    test_request_incomplete_header_with_body();
-    test_request_no_headers();
-    test_request_only_status_line();
-    test_request_incomplete_protocol();
-    test_request_incomplete_protocol_with_body();
+    size_t decoded_len;
+    http_parsing_result_t result = http_decode_chunked(text, sizeof(text) - 1, text, sizeof(text) - 1, &decoded_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){text, decoded_len}, STR("MozillaDeveloper Network")));
+}
 
-    test_decode();
-    test_decode_incomplete();
-    test_decode_length_is_too_big();
-    test_decode_length_is_too_small();
-    test_decode_last_line_invalid();
+static void test_decode_iov() {
+    char text[] =
+        "7\n"
+        "Mozilla\n"
+        "11\n"
+        "Developer Network\n"
+        "0\n"
+        "\n";
+
+    struct iovec iov[4];
+    size_t iov_len;
+    size_t decoded_len;
+    http_parsing_result_t result = http_decode_chunked_iov(text, sizeof(text) - 1, iov, ARRAY_LENGTH(iov), &iov_len, &decoded_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(iov_len == 2);
+    my_assert(decoded_len == strlen("MozillaDeveloper Network"));
+    my_assert(iov[0].iov_base == text + 2);
+    my_assert(strings_match((string){iov[0].iov_base, iov[0].iov_len}, STR("Mozilla")));
+    my_assert(strings_match((string){iov[1].iov_base, iov[1].iov_len}, STR("Developer Network")));
+
+    result = http_decode_chunked_iov(text, sizeof(text) - 1, iov, 1, &iov_len, &decoded_len);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+}
+
+static void test_decode_buffer_too_small() {
+    char text[] =
+        "7\n"
+        "Mozilla\n"
+        "0\n"
+        "\n";
+
+    char decoded[6];
+    size_t decoded_len;
+    http_parsing_result_t result = http_decode_chunked(text, sizeof(text) - 1, decoded, sizeof(decoded), &decoded_len);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+}
+
+static void test_decode_streaming_any_split() {
+    char text[] =
+        "7\r\n"
+        "Mozilla\r\n"
+        "1a\n"
+        "Developer Network, 26 long\n"
+        "0\r\n"
+        "\r\n"
+        "next";
+    size_t body_len = sizeof(text) - 1 - strlen("next");
+
+    // Cut in two at every possible point
+    for (size_t cut = 0; cut < body_len; cut++) {
+        http_chunked_decoder_t decoder;
+        http_chunked_decoder_init(&decoder);
+
+        char decoded[256];
+        size_t consumed;
+        size_t decoded_len;
+        http_parsing_result_t result = http_chunked_decoder_feed(&decoder, text, cut,
+                                                                 decoded, sizeof(decoded),
+                                                                 &consumed, &decoded_len);
+        my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+        my_assert(consumed == cut);
+
+        size_t consumed2;
+        size_t decoded_len2;
+        result = http_chunked_decoder_feed(&decoder, text + cut, sizeof(text) - 1 - cut,
+                                           decoded + decoded_len, sizeof(decoded) - decoded_len,
+                                           &consumed2, &decoded_len2);
+        my_assert(result == PARSING_RES_SUCCEEDED);
+        my_assert(cut + consumed2 == body_len);
+        my_assert(strings_match((string){decoded, decoded_len + decoded_len2}, STR("MozillaDeveloper Network, 26 long")));
+    }
+}
+
+static void test_decode_streaming_small_buffer() {
+    char text[] =
+        "7\n"
+        "Mozilla\n"
+        "11\n"
+        "Developer Network\n"
+        "0\n"
+        "\n";
+
+    http_chunked_decoder_t decoder;
+    http_chunked_decoder_init(&decoder);
+
+    // One byte in, at most three bytes out at a time
+    char decoded[256];
+    size_t decoded_total = 0;
+    http_parsing_result_t result = PARSING_RES_NOT_ENOUGH_DATA;
+    for (size_t i = 0; i < sizeof(text) - 1 && result != PARSING_RES_SUCCEEDED; i++) {
+        size_t consumed;
+        size_t decoded_len;
+        result = http_chunked_decoder_feed(&decoder, text + i, 1, decoded + decoded_total, 3, &consumed, &decoded_len);
+        my_assert(result != PARSING_RES_FAILED);
+        my_assert(consumed == 1);
+        decoded_total += decoded_len;
+    }
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){decoded, decoded_total}, STR("MozillaDeveloper Network")));
+
+    // Out of memory leaves the rest for the next call
+    http_chunked_decoder_init(&decoder);
+    size_t consumed;
+    size_t decoded_len;
+    result = http_chunked_decoder_feed(&decoder, text, sizeof(text) - 1, decoded, 3, &consumed, &decoded_len);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+    my_assert(consumed == strlen("7\nMoz"));
+    my_assert(strings_match((string){decoded, decoded_len}, STR("Moz")));
+}
+
+static void test_decode_streaming_invalid() {
+    char text[] =
+        "7\n"
+        "Mozilla\r"
+        "X\n";
+
+    http_chunked_decoder_t decoder;
+    http_chunked_decoder_init(&decoder);
+
+    char decoded[256];
+    size_t consumed;
+    size_t decoded_len;
+    http_parsing_result_t result = http_chunked_decoder_feed(&decoder, text, sizeof(text) - 1,
+                                                             decoded, sizeof(decoded),
+                                                             &consumed, &decoded_len);
+    my_assert(result == PARSING_RES_FAILED);
+
+    http_chunked_decoder_init(&decoder);
+    result = http_chunked_decoder_feed(&decoder, "\n\n", 2, decoded, sizeof(decoded), &consumed, &decoded_len);
+    my_assert(result == PARSING_RES_FAILED);
+
+    http_chunked_decoder_init(&decoder);
+    result = http_chunked_decoder_feed(&decoder, "11111111111111111\n", 18, decoded, sizeof(decoded), &consumed, &decoded_len);
+    my_assert(result == PARSING_RES_FAILED);
+}
+
+static void test_decode_streaming_same_as_one_shot() {
+    const string bodies[] = {
+        STR("5;name=value\r\nhello\r\n6 ; ext\r\n world\r\n0;last\r\nExpires: never\r\nX-Sum:1\r\n\r\n"),
+        STR("5;\nhello\n0\nA:\n\n"),
+        STR("5 \r\nhello\r\n0\r\n\r\n"),
+        STR("5;a\x01\r\nhello\r\n0\r\n\r\n"),
+        STR("5\rX\nhello\r\n0\r\n\r\n"),
+        STR("0\r\n: empty name\r\n\r\n"),
+        STR("0\r\nBad Name: 1\r\n\r\n"),
+        STR("0\r\nX: a\x7f\r\n\r\n"),
+        STR("0\r\nX: a\rb\r\n\r\n"),
+        STR("000000000000000000005\r\nhello\r\n0\r\n\r\n"),
+        STR("ffffffffffffffff0\r\n"),
+    };
+
+    for (size_t i = 0; i < ARRAY_LENGTH(bodies); i++) {
+        char expected[64];
+        size_t expected_len;
+        http_parsing_result_t expected_result = http_decode_chunked(bodies[i].data, bodies[i].count,
+                                                                    expected, sizeof(expected), &expected_len);
+        my_assert(expected_result == PARSING_RES_SUCCEEDED || expected_result == PARSING_RES_FAILED);
+
+        // Byte by byte, so every stage is entered at the start of a piece
+        http_chunked_decoder_t decoder;
+        http_chunked_decoder_init(&decoder);
+
+        char decoded[64];
+        size_t decoded_total = 0;
+        http_parsing_result_t result = PARSING_RES_NOT_ENOUGH_DATA;
+        for (size_t j = 0; j < bodies[i].count && result == PARSING_RES_NOT_ENOUGH_DATA; j++) {
+            size_t consumed;
+            size_t decoded_len;
+            result = http_chunked_decoder_feed(&decoder, bodies[i].data + j, 1,
+                                               decoded + decoded_total, sizeof(decoded) - decoded_total,
+                                               &consumed, &decoded_len);
+            decoded_total += decoded_len;
+        }
+        my_assert(result == expected_result);
+        if (result == PARSING_RES_SUCCEEDED) {
+            my_assert(strings_match((string){decoded, decoded_total}, (string){expected, expected_len}));
+        }
+    }
+}
+
+static void test_request_continue_byte_by_byte() {
+    char text[] =
+        "POST / HTTP/1.1\n"
+        "Host: localhost:8000\n"
+        "User-Agent: Mozilla/5.0 (Macintosh;...) ... Firefox/51.0\n"
+        "Content-Length: 345\n"
+        "\n"
+        "-12656974\n";
+
+    http_header_t headers_buf[100];
+    http_request_t request;
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    // Feed one more byte on every call, like a very slow client would
+    http_parsing_result_t result = PARSING_RES_NOT_ENOUGH_DATA;
+    size_t len = 0;
+    while (result == PARSING_RES_NOT_ENOUGH_DATA && len < sizeof(text) - 1) {
+        len++;
+        result = http_parse_request_continue(&state, text, len,
+                                             headers_buf, ARRAY_LENGTH(headers_buf),
+                                             &request);
+    }
+
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(len == strlen("POST / HTTP/1.1\nHost: localhost:8000\n"
+                            "User-Agent: Mozilla/5.0 (Macintosh;...) ... Firefox/51.0\nContent-Length: 345\n\n"));
+    my_assert(strings_match((string){request.method, request.method_len}, STR("POST")));
+    my_assert(strings_match((string){request.target, request.target_len}, STR("/")));
+    my_assert(strings_match((string){request.protocol, request.protocol_len}, STR("HTTP/1.1")));
+    my_assert(request.headers_len == 3);
+    my_assert(strings_match((string){request.headers[0].value, request.headers[0].value_len}, STR("localhost:8000")));
+    my_assert(strings_match((string){request.headers[2].name, request.headers[2].name_len}, STR("Content-Length")));
+    my_assert(request.body_len == 0);
+
+    // Once done, more data only extends the body
+    result = http_parse_request_continue(&state, text, sizeof(text) - 1,
+                                         headers_buf, ARRAY_LENGTH(headers_buf),
+                                         &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){request.body, request.body_len}, STR("-12656974\n")));
+}
+
+static void test_request_continue_failed() {
+    char text[] =
+        "POST / HTTP/\n"
+        "Host: localhost:8000\n";
+
+    http_header_t headers_buf[100];
+    http_request_t request;
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    http_parsing_result_t result = http_parse_request_continue(&state, text, strlen("POST / HTTP/\n"),
+                                                               headers_buf, ARRAY_LENGTH(headers_buf),
+                                                               &request);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+
+    result = http_parse_request_continue(&state, text, sizeof(text) - 1,
+                                         headers_buf, ARRAY_LENGTH(headers_buf),
+                                         &request);
+    my_assert(result == PARSING_RES_FAILED);
+}
+
+static void test_response_continue_not_enough_memory() {
+    char text[] =
+        "HTTP/1.1 403 Forbidden\n"
+        "Server: Apache\n"
+        "Age: 3464\n"
+        "X-Cache-Info: caching\n"
+        "\n"
+        "body";
+
+    http_header_t headers_buf[100];
+    http_response_t response;
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    http_parsing_result_t result = http_parse_response_continue(&state, text, sizeof(text) - 1,
+                                                                headers_buf, 2,
+                                                                &response);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+
+    // Resume with a bigger buffer that keeps the headers parsed so far
+    result = http_parse_response_continue(&state, text, sizeof(text) - 1,
+                                          headers_buf, ARRAY_LENGTH(headers_buf),
+                                          &response);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(response.status_code == 403);
+    my_assert(response.headers_len == 3);
+    my_assert(strings_match((string){response.headers[0].name, response.headers[0].name_len}, STR("Server")));
+    my_assert(strings_match((string){response.headers[2].value, response.headers[2].value_len}, STR("caching")));
+    my_assert(strings_match((string){response.body, response.body_len}, STR("body")));
+}
+
+static void test_request_framed_pipelined() {
+    char text[] =
+        "POST /first HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "helloGET /second HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "\r\n"
+        "POST /third HTTP/1.1\r\n"
+        "Content-Length: 10\r\n"
+        "\r\n"
+        "incomp";
+
+    http_header_t headers_buf[100];
+    http_request_t request;
+    size_t consumed;
+    size_t offset = 0;
+
+    http_parsing_result_t result = http_parse_request_framed(text + offset, sizeof(text) - 1 - offset,
+                                                             headers_buf, ARRAY_LENGTH(headers_buf),
+                                                             &request, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){request.target, request.target_len}, STR("/first")));
+    my_assert(request.headers_len == 2);
+    my_assert(strings_match((string){request.headers[1].value, request.headers[1].value_len}, STR("5")));
+    my_assert(strings_match((string){request.body, request.body_len}, STR("hello")));
+    offset += consumed;
+
+    result = http_parse_request_framed(text + offset, sizeof(text) - 1 - offset,
+                                       headers_buf, ARRAY_LENGTH(headers_buf),
+                                       &request, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){request.target, request.target_len}, STR("/second")));
+    my_assert(strings_match((string){request.protocol, request.protocol_len}, STR("HTTP/1.1")));
+    my_assert(request.body_len == 0);
+    offset += consumed;
+
+    // Body of the last one is still on its way
+    result = http_parse_request_framed(text + offset, sizeof(text) - 1 - offset,
+                                       headers_buf, ARRAY_LENGTH(headers_buf),
+                                       &request, &consumed);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+}
+
+static void test_request_framed_invalid_content_length() {
+    char text[] =
+        "POST / HTTP/1.1\n"
+        "Content-Length: 5\n"
+        "Content-Length: 6\n"
+        "\n"
+        "hello!";
+
+    http_header_t headers_buf[100];
+    http_request_t request;
+    size_t consumed;
+    http_parsing_result_t result = http_parse_request_framed(text, sizeof(text) - 1,
+                                                             headers_buf, ARRAY_LENGTH(headers_buf),
+                                                             &request, &consumed);
+    my_assert(result == PARSING_RES_FAILED);
+}
+
+static void test_response_framed_chunked() {
+    char text[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: gzip, Chunked\r\n"
+        "Content-Length: 1000\r\n"
+        "\r\n"
+        "7\r\n"
+        "Mozilla\r\n"
+        "11\r\n"
+        "Developer Network\r\n"
+        "0\r\n"
+        "\r\n"
+        "HTTP/1.1 204 No Content\r\n"
+        "\r\n";
+
+    http_header_t headers_buf[100];
+    http_response_t response;
+    size_t consumed;
+    http_parsing_result_t result = http_parse_response_framed(text, sizeof(text) - 1,
+                                                              headers_buf, ARRAY_LENGTH(headers_buf),
+                                                              &response, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){response.status_text, response.status_text_len}, STR("OK")));
+    my_assert(strings_match((string){response.headers[0].value, response.headers[0].value_len}, STR("gzip, Chunked")));
+    my_assert(strings_match((string){response.body, response.body_len},
+                            STR("7\r\nMozilla\r\n11\r\nDeveloper Network\r\n0\r\n\r\n")));
+
+    {
+        char decoded[256];
+        size_t decoded_len;
+        result = http_decode_chunked(response.body, response.body_len, decoded, sizeof(decoded), &decoded_len);
+        my_assert(result == PARSING_RES_SUCCEEDED);
+        my_assert(strings_match((string){decoded, decoded_len}, STR("MozillaDeveloper Network")));
+    }
+
+    // 204 never has a body, so what follows is not a part of it
+    size_t offset = consumed;
+    result = http_parse_response_framed(text + offset, sizeof(text) - 1 - offset,
+                                        headers_buf, ARRAY_LENGTH(headers_buf),
+                                        &response, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(response.status_code == 204);
+    my_assert(response.body_len == 0);
+    my_assert(offset + consumed == sizeof(text) - 1);
+}
+
+static void test_request_framed_chunked_every_prefix() {
+    char text[] =
+        "POST /upload HTTP/1.1\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "5;name=value\r\n"
+        "hello\r\n"
+        "6 ; ext\r\n"
+        " world\r\n"
+        "0;last\r\n"
+        "Expires: never\r\n"
+        "X-Sum:1\r\n"
+        "\r\n"
+        "GET / HTTP/1.1\r\n\r\n";
+    size_t message_len = sizeof(text) - 1 - strlen("GET / HTTP/1.1\r\n\r\n");
+
+    // Wherever the stream is cut (including right after a CR), the message is just incomplete
+    http_header_t headers_buf[10];
+    http_request_t request;
+    size_t consumed;
+    for (size_t len = 0; len < message_len; len++) {
+        http_parsing_result_t result = http_parse_request_framed(text, len, headers_buf, ARRAY_LENGTH(headers_buf),
+                                                                 &request, &consumed);
+        my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+    }
+
+    http_parsing_result_t result = http_parse_request_framed(text, sizeof(text) - 1, headers_buf, ARRAY_LENGTH(headers_buf),
+                                                             &request, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(consumed == message_len);
+
+    char decoded[64];
+    size_t decoded_len;
+    for (size_t len = 0; len < request.body_len; len++) {
+        result = http_decode_chunked(request.body, len, decoded, sizeof(decoded), &decoded_len);
+        my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+    }
+    result = http_decode_chunked(request.body, request.body_len, decoded, sizeof(decoded), &decoded_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){decoded, decoded_len}, STR("hello world")));
+
+    struct iovec iov[4];
+    size_t iov_len;
+    result = http_decode_chunked_iov(request.body, request.body_len, iov, ARRAY_LENGTH(iov), &iov_len, &decoded_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(iov_len == 2 && decoded_len == strlen("hello world"));
+
+    const string invalid[] = {
+        STR("5 \r\nhello\r\n0\r\n\r\n"),          // whitespace without extensions
+        STR("5;a\x01\r\nhello\r\n0\r\n\r\n"),     // control character in extensions
+        STR("5\rX\nhello\r\n0\r\n\r\n"),          // CR in the middle of the size line
+        STR("0\r\n: empty name\r\n\r\n"),
+        STR("0\r\nBad Name: 1\r\n\r\n"),
+        STR("0\r\nX: a\x7f\r\n\r\n"),
+    };
+    for (size_t i = 0; i < ARRAY_LENGTH(invalid); i++) {
+        result = http_decode_chunked(invalid[i].data, invalid[i].count, decoded, sizeof(decoded), &decoded_len);
+        my_assert(result == PARSING_RES_FAILED);
+    }
+}
+
+static void test_response_framed_until_close() {
+    char text[] =
+        "HTTP/1.0 200 OK\n"
+        "Server: Apache\n"
+        "\n"
+        "everything until the connection is closed";
+
+    http_header_t headers_buf[100];
+    http_response_t response;
+    size_t consumed;
+    http_parsing_result_t result = http_parse_response_framed(text, sizeof(text) - 1,
+                                                              headers_buf, ARRAY_LENGTH(headers_buf),
+                                                              &response, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){response.body, response.body_len}, STR("everything until the connection is closed")));
+    my_assert(consumed == sizeof(text) - 1);
+}
+
+static void test_request_batch() {
+    char text[] =
+        "GET /a HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Accept: */*\r\n"
+        "\r\n"
+        "POST /b HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Length: 4\r\n"
+        "\r\n"
+        "bodyGET /c HTTP/1.1\r\n"
+        "\r\n"
+        "GET /d HTTP/1.1\r\n"
+        "Host: loc";
+
+    http_header_t headers_pool[100];
+    http_request_t requests[10];
+    size_t count;
+    size_t consumed;
+    http_parsing_result_t result = http_parse_requests_batch(text, sizeof(text) - 1,
+                                                             headers_pool, ARRAY_LENGTH(headers_pool),
+                                                             requests, ARRAY_LENGTH(requests),
+                                                             &count, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(count == 3);
+    my_assert(strings_match((string){text + consumed, sizeof(text) - 1 - consumed}, STR("GET /d HTTP/1.1\r\nHost: loc")));
+
+    my_assert(strings_match((string){requests[0].target, requests[0].target_len}, STR("/a")));
+    my_assert(requests[0].headers == headers_pool);
+    my_assert(requests[0].headers_len == 2);
+
+    my_assert(strings_match((string){requests[1].target, requests[1].target_len}, STR("/b")));
+    my_assert(requests[1].headers == headers_pool + 2);
+    my_assert(requests[1].headers_len == 2);
+    my_assert(strings_match((string){requests[1].headers[1].name, requests[1].headers[1].name_len}, STR("Content-Length")));
+    my_assert(strings_match((string){requests[1].body, requests[1].body_len}, STR("body")));
+
+    my_assert(strings_match((string){requests[2].target, requests[2].target_len}, STR("/c")));
+    my_assert(requests[2].headers_len == 0);
+
+    // Runs out of request structures after the first one
+    result = http_parse_requests_batch(text, sizeof(text) - 1,
+                                       headers_pool, ARRAY_LENGTH(headers_pool),
+                                       requests, 1,
+                                       &count, &consumed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(count == 1);
+
+    // Runs out of headers in the first one
+    result = http_parse_requests_batch(text, sizeof(text) - 1,
+                                       headers_pool, 1,
+                                       requests, ARRAY_LENGTH(requests),
+                                       &count, &consumed);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+    my_assert(count == 0);
+    my_assert(consumed == 0);
+}
+
+static void test_request_batch_failed() {
+    char text[] =
+        "GET /a HTTP/1.1\n"
+        "\n"
+        "GET /b HTTP/2.0\n"
+        "\n";
+
+    http_header_t headers_pool[100];
+    http_request_t requests[10];
+    size_t count;
+    size_t consumed;
+    http_parsing_result_t result = http_parse_requests_batch(text, sizeof(text) - 1,
+                                                             headers_pool, ARRAY_LENGTH(headers_pool),
+                                                             requests, ARRAY_LENGTH(requests),
+                                                             &count, &consumed);
+    my_assert(result == PARSING_RES_FAILED);
+    my_assert(count == 1);
+    my_assert(strings_match((string){requests[0].target, requests[0].target_len}, STR("/a")));
+}
+
+static void test_request_compact() {
+    char text[] =
+        "GET /index.html HTTP/1.1\r\n"
+        "Host:example.com\r\n"
+        "Accept: \t text/html\r\n"
+        "X-Custom: 1\r\n"
+        "\r\n";
+
+    http_compact_header_t headers_buf[10];
+    http_request_t request;
+    size_t headers_len;
+
+    http_parsing_result_t result = http_parse_request_compact(text, sizeof(text) - 1,
+                                                              headers_buf, ARRAY_LENGTH(headers_buf),
+                                                              &request, &headers_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){request.target, request.target_len}, STR("/index.html")));
+    my_assert(request.headers == NULL);
+    my_assert(headers_len == 3);
+    my_assert(sizeof(headers_buf[0]) == 8);
+
+    my_assert(strings_match((string){http_compact_header_name(text, &headers_buf[0]), headers_buf[0].name_len}, STR("Host")));
+    my_assert(strings_match((string){http_compact_header_value(text, &headers_buf[0]), headers_buf[0].value_len}, STR("example.com")));
+    my_assert(strings_match((string){http_compact_header_value(text, &headers_buf[1]), headers_buf[1].value_len}, STR("text/html")));
+
+    // Same as parsing with full headers
+    http_header_t full_headers_buf[10];
+    http_request_t full_request;
+    result = http_parse_request(text, sizeof(text) - 1, full_headers_buf, ARRAY_LENGTH(full_headers_buf), &full_request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    for (size_t i = 0; i < headers_len; i++) {
+        http_header_t header;
+        http_compact_header_expand(text, &headers_buf[i], &header);
+        my_assert(header.name == full_request.headers[i].name && header.name_len == full_request.headers[i].name_len);
+        my_assert(header.value == full_request.headers[i].value && header.value_len == full_request.headers[i].value_len);
+        my_assert(header.id == full_request.headers[i].id);
+    }
+
+    result = http_parse_request_compact(text, sizeof(text) - 1, headers_buf, 2, &request, &headers_len);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+}
+
+static void test_response_compact_continue_value_too_long() {
+    static char text[100000];
+    size_t len = (size_t) sprintf(text, "HTTP/1.1 200 OK\r\nServer: Apache\r\nX-Big: ");
+    memset(text + len, 'a', 70000);
+    len += 70000;
+    len += (size_t) sprintf(text + len, "\r\n\r\n");
+
+    http_compact_header_t headers_buf[10];
+    http_response_t response;
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+
+    // The first header is kept, the one after it doesn't fit
+    http_parsing_result_t result = http_parse_response_compact_continue(&state, text, 40,
+                                                                        headers_buf, ARRAY_LENGTH(headers_buf),
+                                                                        &response);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+    my_assert(state.headers_len == 1);
+    my_assert(response.status_code == 200);
+
+    result = http_parse_response_compact_continue(&state, text, len,
+                                                  headers_buf, ARRAY_LENGTH(headers_buf),
+                                                  &response);
+    my_assert(result == PARSING_RES_FAILED);
+    my_assert(strings_match((string){http_compact_header_value(text, &headers_buf[0]), headers_buf[0].value_len}, STR("Apache")));
+}
+
+static size_t make_request_with_headers(char* text, size_t text_size, size_t num_headers) {
+    size_t len = (size_t) snprintf(text, text_size, "GET / HTTP/1.1\r\n");
+    for (size_t i = 0; i < num_headers; i++) {
+        len += (size_t) snprintf(text + len, text_size - len, "X-Header-%zu: value %zu\r\n", i, i);
+    }
+    len += (size_t) snprintf(text + len, text_size - len, "\r\n");
+    return len;
+}
+
+typedef struct {
+    void* blocks[8];
+    size_t num_blocks;
+} arena_blocks_t;
+
+static void* grow_arena(void* user_data, size_t min_size, size_t* out_size) {
+    arena_blocks_t* blocks = user_data;
+    if (blocks->num_blocks == ARRAY_LENGTH(blocks->blocks)) {
+        return NULL;
+    }
+
+    *out_size = min_size * 2;
+    void* block = malloc(*out_size);
+    blocks->blocks[blocks->num_blocks++] = block;
+    return block;
+}
+
+static void release_arena_block(void* user_data, void* block, size_t size) {
+    arena_blocks_t* blocks = user_data;
+    my_assert(size > 0);
+
+    // Newest block first
+    my_assert(blocks->num_blocks > 0 && blocks->blocks[blocks->num_blocks - 1] == block);
+    blocks->num_blocks--;
+    free(block);
+}
+
+static void test_request_arena_grows_in_place() {
+    char text[4096];
+    size_t len = make_request_with_headers(text, sizeof(text), 40);
+
+    static char arena_buf[8192];
+    http_arena_t arena;
+    http_arena_init(&arena, arena_buf, sizeof(arena_buf), NULL, NULL, NULL);
+
+    http_request_t request;
+    http_parsing_result_t result = http_parse_request_arena(text, len, &arena, &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(request.headers_len == 40);
+    my_assert(strings_match((string){request.headers[0].name, request.headers[0].name_len}, STR("X-Header-0")));
+    my_assert(strings_match((string){request.headers[39].value, request.headers[39].value_len}, STR("value 39")));
+
+    // Nothing but the headers is left in the arena
+    my_assert((char*) request.headers >= arena_buf);
+    my_assert(arena.used == (size_t) ((char*) (request.headers + 40) - arena_buf));
+
+    // Next request of the connection reuses the memory
+    http_arena_reset(&arena);
+    result = http_parse_request_arena(text, len, &arena, &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(request.headers_len == 40);
+}
+
+static void test_request_arena_grows_into_new_block() {
+    char text[4096];
+    size_t len = make_request_with_headers(text, sizeof(text), 50);
+
+    static char arena_buf[1024];
+    arena_blocks_t blocks = {0};
+    http_arena_t arena;
+    http_arena_init(&arena, arena_buf, sizeof(arena_buf), grow_arena, release_arena_block, &blocks);
+
+    // Arena is already partly used, there's no room to grow the header array in place
+    my_assert(http_arena_alloc(&arena, 100, 1) != NULL);
+
+    http_request_t request;
+    http_parsing_result_t result = http_parse_request_arena(text, len, &arena, &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(blocks.num_blocks > 0);
+    my_assert(request.headers_len == 50);
+    for (size_t i = 0; i < 50; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "X-Header-%zu", i);
+        my_assert(strings_match((string){request.headers[i].name, request.headers[i].name_len}, (string){name, strlen(name)}));
+    }
+
+    // Reset gives every grown block back and starts over in arena_buf
+    http_arena_reset(&arena);
+    my_assert(blocks.num_blocks == 0);
+    my_assert(arena.data == arena_buf && arena.size == sizeof(arena_buf) && arena.used == 0);
+
+    my_assert(http_arena_alloc(&arena, 100, 1) == arena_buf);
+}
+
+static void test_request_arena_full() {
+    char text[4096];
+    size_t len = make_request_with_headers(text, sizeof(text), 40);
+
+    static char arena_buf[1024];
+    http_arena_t arena;
+    http_arena_init(&arena, arena_buf, sizeof(arena_buf), NULL, NULL, NULL);
+
+    http_request_t request;
+    http_parsing_result_t result = http_parse_request_arena(text, len, &arena, &request);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+}
+
+typedef struct {
+    string method;
+    string target;
+    uint16_t status_code;
+    string status_text;
+    size_t headers_len;
+    string last_header_value;
+    bool headers_complete;
+    string body;
+
+    size_t stop_at_header; // stop when this many headers are seen, 0 to never stop
+} callback_log_t;
+
+static int log_method(void* user_data, const char* method, size_t method_len) {
+    ((callback_log_t*) user_data)->method = (string){method, method_len};
+    return 0;
+}
+
+static int log_target(void* user_data, const char* target, size_t target_len) {
+    ((callback_log_t*) user_data)->target = (string){target, target_len};
+    return 0;
+}
+
+static int log_status(void* user_data, uint16_t status_code, const char* status_text, size_t status_text_len) {
+    ((callback_log_t*) user_data)->status_code = status_code;
+    ((callback_log_t*) user_data)->status_text = (string){status_text, status_text_len};
+    return 0;
+}
+
+static int log_header(void* user_data, const http_header_t* header) {
+    callback_log_t* log = user_data;
+    log->headers_len++;
+    log->last_header_value = (string){header->value, header->value_len};
+    return log->headers_len == log->stop_at_header;
+}
+
+static int log_headers_complete(void* user_data) {
+    ((callback_log_t*) user_data)->headers_complete = true;
+    return 0;
+}
+
+static int log_body(void* user_data, const char* body, size_t body_len) {
+    ((callback_log_t*) user_data)->body = (string){body, body_len};
+    return 0;
+}
+
+static const http_parser_callbacks_t log_callbacks = {
+    log_method, log_target, log_status, log_header, log_headers_complete, log_body,
+};
+
+static void test_request_callbacks() {
+    char text[8192];
+    size_t len = make_request_with_headers(text, sizeof(text), 200);
+    len += (size_t) snprintf(text + len, sizeof(text) - len, "body");
+
+    // There's no limit on the number of headers
+    callback_log_t log = {0};
+    http_parsing_result_t result = http_parse_request_cb(text, len, &log_callbacks, &log);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match(log.method, STR("GET")));
+    my_assert(strings_match(log.target, STR("/")));
+    my_assert(log.headers_len == 200);
+    my_assert(strings_match(log.last_header_value, STR("value 199")));
+    my_assert(log.headers_complete);
+    my_assert(strings_match(log.body, STR("body")));
+
+    // Missing callbacks are skipped
+    http_parser_callbacks_t only_headers = {0};
+    only_headers.on_header = log_header;
+    log = (callback_log_t) {0};
+    result = http_parse_request_cb(text, len, &only_headers, &log);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(log.headers_len == 200);
+    my_assert(log.method.data == NULL);
+}
+
+static void test_response_callbacks_stopped() {
+    char text[] =
+        "HTTP/1.1 403 Forbidden\n"
+        "Server: Apache\n"
+        "Age: 3464\n"
+        "X-Cache-Info: caching\n"
+        "\n"
+        "body";
+
+    callback_log_t log = {0};
+    log.stop_at_header = 2;
+    http_parsing_result_t result = http_parse_response_cb(text, sizeof(text) - 1, &log_callbacks, &log);
+    my_assert(result == PARSING_RES_STOPPED);
+    my_assert(log.status_code == 403);
+    my_assert(strings_match(log.status_text, STR("Forbidden")));
+    my_assert(log.headers_len == 2);
+    my_assert(strings_match(log.last_header_value, STR("3464")));
+    my_assert(!log.headers_complete);
+    my_assert(log.body.data == NULL);
+
+    // Incomplete message, everything up to where it ends is passed
+    log = (callback_log_t) {0};
+    result = http_parse_response_cb(text, strlen("HTTP/1.1 403 Forbidden\nServer: Apache\nAg"), &log_callbacks, &log);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+    my_assert(log.headers_len == 1);
+}
+
+static string join_iov(const struct iovec* iov, size_t iov_len, char* buf, size_t buf_len) {
+    size_t len = 0;
+    for (size_t i = 0; i < iov_len; i++) {
+        my_assert(len + iov[i].iov_len <= buf_len);
+        memcpy(buf + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+    return (string){buf, len};
+}
+
+static void test_serialize_response() {
+    char text[] =
+        "HTTP/1.1 403 Forbidden\n"
+        "Server:   Apache\n"
+        "Age: 3464\n"
+        "\n"
+        "body";
+
+    http_header_t headers_buf[10];
+    http_response_t response;
+    http_parsing_result_t result = http_parse_response(text, sizeof(text) - 1, headers_buf, ARRAY_LENGTH(headers_buf), &response);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    struct iovec iov[16];
+    size_t iov_len;
+    size_t total_len;
+    char scratch[HTTP_SERIALIZE_SCRATCH_LEN];
+    result = http_serialize_response(&response, iov, ARRAY_LENGTH(iov), scratch, sizeof(scratch), &iov_len, &total_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    char buf[256];
+    string serialized = join_iov(iov, iov_len, buf, sizeof(buf));
+    my_assert(strings_match(serialized, STR("HTTP/1.1 403 Forbidden\r\nServer: Apache\r\nAge: 3464\r\n\r\nbody")));
+    my_assert(total_len == serialized.count);
+
+    // Body is referenced, not copied
+    my_assert(iov[iov_len - 1].iov_base == response.body);
+
+    result = http_serialize_response(&response, iov, 5, scratch, sizeof(scratch), &iov_len, &total_len);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+
+    response.status_code = 42;
+    result = http_serialize_response(&response, iov, ARRAY_LENGTH(iov), scratch, sizeof(scratch), &iov_len, &total_len);
+    my_assert(result == PARSING_RES_FAILED);
+}
+
+static void test_serialize_request() {
+    http_header_t headers[] = {
+        {"Host", 4, "localhost", 9, HTTP_HEADER_HOST},
+        {"Content-Length", 14, "5", 1, HTTP_HEADER_CONTENT_LENGTH},
+    };
+
+    http_request_t request = {0};
+    request.method      = "PUT";
+    request.method_len  = 3;
+    request.target      = "/a?b=c";
+    request.target_len  = 6;
+    request.headers     = headers;
+    request.headers_len = ARRAY_LENGTH(headers);
+    request.body        = "hello";
+    request.body_len    = 5;
+
+    struct iovec iov[16];
+    size_t iov_len;
+    size_t total_len;
+    http_parsing_result_t result = http_serialize_request(&request, iov, ARRAY_LENGTH(iov), &iov_len, &total_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    char buf[256];
+    string serialized = join_iov(iov, iov_len, buf, sizeof(buf));
+    my_assert(strings_match(serialized, STR("PUT /a?b=c HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello")));
+
+    // Parses back to the same request
+    http_header_t headers_buf[10];
+    http_request_t parsed;
+    result = http_parse_request(serialized.data, serialized.count, headers_buf, ARRAY_LENGTH(headers_buf), &parsed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){parsed.target, parsed.target_len}, STR("/a?b=c")));
+    my_assert(parsed.headers_len == 2);
+    my_assert(strings_match((string){parsed.body, parsed.body_len}, STR("hello")));
+}
+
+static void test_rewrite_request() {
+    char text[] =
+        "GET /page HTTP/1.1\r\n"
+        "Host: internal\r\n"
+        "Connection: keep-alive\r\n"
+        "Accept: */*\n"
+        "keep-alive: timeout=5\r\n"
+        "User-Agent: test\r\n"
+        "\r\n"
+        "body";
+
+    http_header_t headers_buf[10];
+    http_request_t request;
+    http_parsing_result_t result = http_parse_request(text, sizeof(text) - 1, headers_buf, ARRAY_LENGTH(headers_buf), &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    struct iovec iov[16];
+    size_t iov_len;
+    size_t total_len;
+    char buf[512];
+
+    // Without edits the message is referenced as it is
+    http_rewrite_edit_t edits[8];
+    char edits_buf[128];
+    http_rewrite_t rewrite;
+    http_rewrite_init(&rewrite, edits, ARRAY_LENGTH(edits), edits_buf, sizeof(edits_buf));
+    result = http_rewrite_request(&rewrite, &request, iov, ARRAY_LENGTH(iov), &iov_len, &total_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(iov_len == 1 && iov[0].iov_base == text && total_len == sizeof(text) - 1);
+
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REMOVE, "Connection", 10, NULL, 0) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REMOVE, "Keep-Alive", 10, NULL, 0) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REPLACE, "Host", 4, "example.com", 11) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_ADD, "X-Forwarded-For", 15, "192.0.2.1", 9) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REPLACE, "Via", 3, "1.1 proxy", 9) == PARSING_RES_SUCCEEDED);
+
+    result = http_rewrite_request(&rewrite, &request, iov, ARRAY_LENGTH(iov), &iov_len, &total_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    string rewritten = join_iov(iov, iov_len, buf, sizeof(buf));
+    my_assert(strings_match(rewritten, STR("GET /page HTTP/1.1\r\n"
+                                           "Host: example.com\r\n"
+                                           "Accept: */*\n"
+                                           "User-Agent: test\r\n"
+                                           "X-Forwarded-For: 192.0.2.1\r\n"
+                                           "Via: 1.1 proxy\r\n"
+                                           "\r\n"
+                                           "body")));
+    my_assert(total_len == rewritten.count);
+
+    // Only new lines are copied; the start line, kept headers and the body are in the original buffer
+    my_assert(iov[0].iov_base == text);
+    my_assert(iov[iov_len - 1].iov_base == text + strlen(text) - strlen("\r\nbody"));
+    my_assert(iov_len <= 2 + request.headers_len + rewrite.edits_len);
+
+    http_header_t parsed_headers[10];
+    http_request_t parsed;
+    result = http_parse_request(rewritten.data, rewritten.count, parsed_headers, ARRAY_LENGTH(parsed_headers), &parsed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(parsed.headers_len == 5);
+    my_assert(parsed.info.keep_alive);
+
+    result = http_rewrite_request(&rewrite, &request, iov, 2, &iov_len, &total_len);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_MEMORY);
+
+    // Edits that could break the message
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_ADD, "Bad Name", 8, "1", 1) == PARSING_RES_FAILED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_ADD, "", 0, "1", 1) == PARSING_RES_FAILED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_ADD, "X", 1, "1\r\nEvil: 1", 10) == PARSING_RES_FAILED);
+
+    // Full edits or buffer
+    char long_value[sizeof(edits_buf)];
+    memset(long_value, 'a', sizeof(long_value));
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_ADD, "X", 1, long_value, sizeof(long_value)) == PARSING_RES_NOT_ENOUGH_MEMORY);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REMOVE, "A", 1, NULL, 0) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REMOVE, "B", 1, NULL, 0) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REMOVE, "C", 1, NULL, 0) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REMOVE, "D", 1, NULL, 0) == PARSING_RES_NOT_ENOUGH_MEMORY);
+}
+
+static void test_rewrite_response() {
+    char text[] =
+        "HTTP/1.1 200 OK\n"
+        "Server: a\n"
+        "Set-Cookie: x=1\n"
+        "Set-Cookie: y=2\n"
+        "\n";
+
+    http_header_t headers_buf[10];
+    http_response_t response;
+    http_parsing_result_t result = http_parse_response(text, sizeof(text) - 1, headers_buf, ARRAY_LENGTH(headers_buf), &response);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    http_rewrite_edit_t edits[4];
+    char edits_buf[64];
+    http_rewrite_t rewrite;
+    http_rewrite_init(&rewrite, edits, ARRAY_LENGTH(edits), edits_buf, sizeof(edits_buf));
+
+    // Every repeated header is replaced by one line
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REPLACE, "set-cookie", 10, "z=3", 3) == PARSING_RES_SUCCEEDED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REPLACE, "Server", 6, "b", 1) == PARSING_RES_SUCCEEDED);
+
+    // Lines that the parser wouldn't take back
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_REPLACE, "Server", 6, "", 0) == PARSING_RES_FAILED);
+    my_assert(http_rewrite_add_edit(&rewrite, HTTP_REWRITE_ADD, "X-Empty", 7, "", 0) == PARSING_RES_FAILED);
+
+    struct iovec iov[16];
+    size_t iov_len;
+    size_t total_len;
+    result = http_rewrite_response(&rewrite, &response, iov, ARRAY_LENGTH(iov), &iov_len, &total_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+
+    char buf[256];
+    string rewritten = join_iov(iov, iov_len, buf, sizeof(buf));
+    my_assert(strings_match(rewritten, STR("HTTP/1.1 200 OK\nServer: b\r\nset-cookie: z=3\r\n\n")));
+    my_assert(total_len == rewritten.count);
+
+    http_header_t parsed_headers[10];
+    http_response_t parsed;
+    result = http_parse_response(rewritten.data, rewritten.count, parsed_headers, ARRAY_LENGTH(parsed_headers), &parsed);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(parsed.headers_len == 2);
+}
+
+static void test_parse_target() {
+    http_target_t target;
+
+    string origin = STR("/search/a%20b?q=1&x#top");
+    my_assert(http_parse_target(origin.data, origin.count, &target) == PARSING_RES_SUCCEEDED);
+    my_assert(target.form == HTTP_TARGET_ORIGIN);
+    my_assert(target.scheme == NULL && target.authority == NULL);
+    my_assert(strings_match((string){target.path, target.path_len}, STR("/search/a%20b")));
+    my_assert(strings_match((string){target.query, target.query_len}, STR("q=1&x")));
+    my_assert(strings_match((string){target.fragment, target.fragment_len}, STR("top")));
+
+    string absolute = STR("http://example.com:8080/index.html?a=b");
+    my_assert(http_parse_target(absolute.data, absolute.count, &target) == PARSING_RES_SUCCEEDED);
+    my_assert(target.form == HTTP_TARGET_ABSOLUTE);
+    my_assert(strings_match((string){target.scheme, target.scheme_len}, STR("http")));
+    my_assert(strings_match((string){target.authority, target.authority_len}, STR("example.com:8080")));
+    my_assert(strings_match((string){target.path, target.path_len}, STR("/index.html")));
+    my_assert(strings_match((string){target.query, target.query_len}, STR("a=b")));
+    my_assert(target.fragment == NULL);
+
+    // Absolute form without a path
+    string no_path = STR("https://example.com?x");
+    my_assert(http_parse_target(no_path.data, no_path.count, &target) == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){target.authority, target.authority_len}, STR("example.com")));
+    my_assert(target.path_len == 0);
+    my_assert(strings_match((string){target.query, target.query_len}, STR("x")));
+
+    string authority = STR("example.com:443");
+    my_assert(http_parse_target(authority.data, authority.count, &target) == PARSING_RES_SUCCEEDED);
+    my_assert(target.form == HTTP_TARGET_AUTHORITY);
+    my_assert(strings_match((string){target.authority, target.authority_len}, STR("example.com:443")));
+
+    my_assert(http_parse_target("*", 1, &target) == PARSING_RES_SUCCEEDED);
+    my_assert(target.form == HTTP_TARGET_ASTERISK);
+
+    my_assert(http_parse_target("", 0, &target) == PARSING_RES_FAILED);
+    my_assert(http_parse_target("index.html", 10, &target) == PARSING_RES_FAILED);
+    my_assert(http_parse_target("example.com:", 12, &target) == PARSING_RES_FAILED);
+}
+
+static void test_percent_decode() {
+    // Long enough for the escapes to be found in different vector blocks
+    char path[] = "/files/some%20long%20directory%20name/and+a+file%2Ename%3f";
+    size_t len;
+    my_assert(http_percent_decode(path, strlen(path), false, &len) == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){path, len}, STR("/files/some long directory name/and+a+file.name?")));
+
+    char query[] = "a+b%2Bc+%e2%82%ac";
+    my_assert(http_percent_decode(query, strlen(query), true, &len) == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){query, len}, STR("a b+c \xe2\x82\xac")));
+
+    char plain[] = "nothing-to-decode";
+    my_assert(http_percent_decode(plain, strlen(plain), true, &len) == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){plain, len}, STR("nothing-to-decode")));
+
+    char bad_digit[] = "a%2g";
+    my_assert(http_percent_decode(bad_digit, strlen(bad_digit), false, &len) == PARSING_RES_FAILED);
+
+    char truncated[] = "abc%2";
+    my_assert(http_percent_decode(truncated, strlen(truncated), false, &len) == PARSING_RES_FAILED);
+}
+
+static void test_query_iter() {
+    string query = STR("a=1&&flag&b=&=x&c=3=4");
+
+    http_query_iter_t iter;
+    http_query_iter_init(&iter, query.data, query.count);
+
+    static const struct { string key; string value; } expected[] = {
+        {STR("a"), STR("1")},
+        {STR("flag"), STR("")},
+        {STR("b"), STR("")},
+        {STR(""), STR("x")},
+        {STR("c"), STR("3=4")},
+    };
+
+    http_query_param_t param;
+    for (size_t i = 0; i < ARRAY_LENGTH(expected); i++) {
+        my_assert(http_query_next(&iter, &param));
+        my_assert(strings_match((string){param.key, param.key_len}, expected[i].key));
+        my_assert(strings_match((string){param.value, param.value_len}, expected[i].value));
+    }
+    my_assert(!http_query_next(&iter, &param));
+
+    http_query_iter_init(&iter, "", 0);
+    my_assert(!http_query_next(&iter, &param));
+}
+
+static void test_decode_hex_sizes() {
+    // Letters in both cases, and leading zeros past 8 digits
+    char text[] =
+        "a\r\n"
+        "0123456789\r\n"
+        "0000000001B\r\n"
+        "abcdefghijklmnopqrstuvwxyz0\r\n"
+        "0\r\n"
+        "\r\n";
+
+    char decoded[64];
+    size_t decoded_len;
+    http_parsing_result_t result = http_decode_chunked(text, sizeof(text) - 1, decoded, sizeof(decoded), &decoded_len);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){decoded, decoded_len}, STR("0123456789abcdefghijklmnopqrstuvwxyz0")));
+
+    // Sizes past 32 bits are fine, that chunk just isn't here yet
+    char huge[] =
+        "100000000\r\n"
+        "abc";
+    result = http_decode_chunked(huge, sizeof(huge) - 1, decoded, sizeof(decoded), &decoded_len);
+    my_assert(result == PARSING_RES_NOT_ENOUGH_DATA);
+
+    // 17 significant digits don't fit
+    char too_big[] =
+        "10000000000000000\r\n";
+    result = http_decode_chunked(too_big, sizeof(too_big) - 1, decoded, sizeof(decoded), &decoded_len);
+    my_assert(result == PARSING_RES_FAILED);
+
+    char not_hex[] =
+        "1g\r\n";
+    result = http_decode_chunked(not_hex, sizeof(not_hex) - 1, decoded, sizeof(decoded), &decoded_len);
+    my_assert(result == PARSING_RES_FAILED);
+}
+
+static void test_parse_content_length() {
+    uint64_t length;
+    my_assert(http_parse_content_length("0", 1, &length) == PARSING_RES_SUCCEEDED && length == 0);
+    my_assert(http_parse_content_length("1234", 4, &length) == PARSING_RES_SUCCEEDED && length == 1234);
+    my_assert(http_parse_content_length("123456789012", 12, &length) == PARSING_RES_SUCCEEDED);
+    my_assert(length == 123456789012ull);
+    my_assert(http_parse_content_length("0000000000000000000000042", 25, &length) == PARSING_RES_SUCCEEDED);
+    my_assert(length == 42);
+
+    my_assert(http_parse_content_length("18446744073709551615", 20, &length) == PARSING_RES_SUCCEEDED);
+    my_assert(length == UINT64_MAX);
+    my_assert(http_parse_content_length("18446744073709551616", 20, &length) == PARSING_RES_FAILED);
+    my_assert(http_parse_content_length("99999999999999999999", 20, &length) == PARSING_RES_FAILED);
+
+    my_assert(http_parse_content_length("", 0, &length) == PARSING_RES_FAILED);
+    my_assert(http_parse_content_length("12a", 3, &length) == PARSING_RES_FAILED);
+    my_assert(http_parse_content_length("-1", 2, &length) == PARSING_RES_FAILED);
+    my_assert(http_parse_content_length("1 2", 3, &length) == PARSING_RES_FAILED);
+    my_assert(http_parse_content_length("12345678:", 9, &length) == PARSING_RES_FAILED);
+}
+
+static void test_response_status_code_out_of_range() {
+    char text[] =
+        "HTTP/1.1 70000 Big\r\n"
+        "\r\n";
+
+    http_header_t headers[4];
+    http_response_t response;
+    http_parsing_result_t result = http_parse_response(text, sizeof(text) - 1, headers, ARRAY_LENGTH(headers), &response);
+    my_assert(result == PARSING_RES_FAILED);
+}
+
+static void test_request_invalid_header_characters() {
+    const string invalid[] = {
+        STR("GET / HTTP/1.1\r\nHost : example.com\r\n\r\n"),  // whitespace before ':'
+        STR("GET / HTTP/1.1\r\nX(Y): 1\r\n\r\n"),
+        STR("GET / HTTP/1.1\r\n: no name\r\n\r\n"),
+        STR("GET / HTTP/1.1\r\nX-Y: a\x01b\r\n\r\n"),
+        STR("GET / HTTP/1.1\r\nX-Y: a\x7f\r\n\r\n"),
+        STR("GET / HTTP/1.1\r\nX-Y: bare\rcr\r\n\r\n"),
+        STR("GET /\0 HTTP/1.1\r\n\r\n"),
+    };
+
+    for (size_t i = 0; i < ARRAY_LENGTH(invalid); i++) {
+        http_header_t headers[4];
+        http_request_t request;
+        http_parsing_result_t result = http_parse_request(invalid[i].data, invalid[i].count, headers, ARRAY_LENGTH(headers), &request);
+        my_assert(result == PARSING_RES_FAILED);
+    }
+
+    // Tab and obs-text are allowed in values, '|' and '~' in names
+    char text[] = "GET / HTTP/1.1\r\nX|Y~: a\tb\xc3\xa9\r\n\r\n";
+    http_header_t headers[4];
+    http_request_t request;
+    http_parsing_result_t result = http_parse_request(text, sizeof(text) - 1, headers, ARRAY_LENGTH(headers), &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){headers[0].name, headers[0].name_len}, STR("X|Y~")));
+    my_assert(strings_match((string){headers[0].value, headers[0].value_len}, STR("a\tb\xc3\xa9")));
+}
+
+static void test_request_invalid_characters_any_position() {
+    // Long enough for every vector width, with the invalid character at every position
+    const size_t len = 100;
+    char text[256];
+
+    for (size_t bad = 0; bad <= len; bad++) {
+        for (int in_value = 0; in_value < 2; in_value++) {
+            size_t pos = 0;
+            pos += (size_t) sprintf(text, "GET / HTTP/1.1\r\n");
+            char* name = text + pos;
+            for (size_t i = 0; i < len; i++) {
+                // Include the token characters that SSE4.2 ranges treat as non-tokens
+                name[i] = "ab|~-_.9"[i % 8];
+            }
+            pos += len;
+            pos += (size_t) sprintf(text + pos, ": ");
+            char* value = text + pos;
+            memset(value, 'v', len);
+            pos += len;
+            pos += (size_t) sprintf(text + pos, "\r\n\r\n");
+
+            if (bad < len) {
+                if (in_value) {
+                    value[bad] = '\x1f';
+                } else {
+                    name[bad] = '@';
+                }
+            }
+
+            http_header_t headers[4];
+            http_request_t request;
+            http_parsing_result_t result = http_parse_request(text, pos, headers, ARRAY_LENGTH(headers), &request);
+            my_assert(result == (bad < len ? PARSING_RES_FAILED : PARSING_RES_SUCCEEDED));
+        }
+    }
+}
+
+static void test_parser_stats() {
+    http_parser_stats_t stats;
+#if !defined(HTTP_PARSER_STATS)
+    my_assert(!http_parser_stats_get(&stats));
+    my_assert(stats.messages == 0 && stats.bytes_scanned == 0);
+#else
+    http_parser_stats_reset();
+
+    http_header_t headers[8];
+    http_request_t request;
+
+    char complete[] =
+        "GET / HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Accept: */*\r\n"
+        "\r\n";
+    my_assert(http_parse_request(complete, sizeof(complete) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_SUCCEEDED);
+
+    char partial[] =
+        "GET / HTTP/1.1\r\n"
+        "Host: exa";
+    my_assert(http_parse_request(partial, sizeof(partial) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_NOT_ENOUGH_DATA);
+
+    char bad_header[] =
+        "GET / HTTP/1.1\r\n"
+        "Host : example.com\r\n"
+        "\r\n";
+    my_assert(http_parse_request(bad_header, sizeof(bad_header) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_FAILED);
+
+    char too_many[] =
+        "GET / HTTP/1.1\r\n"
+        "A: 1\r\n"
+        "B: 2\r\n"
+        "\r\n";
+    my_assert(http_parse_request(too_many, sizeof(too_many) - 1, headers, 1, &request) == PARSING_RES_NOT_ENOUGH_MEMORY);
+
+    char chunked[] = "3\r\nabc\r\n0\r\n\r\n";
+    char bad_chunked[] = "x\r\n";
+    char decoded[16];
+    size_t decoded_len;
+    my_assert(http_decode_chunked(chunked, sizeof(chunked) - 1, decoded, sizeof(decoded), &decoded_len) == PARSING_RES_SUCCEEDED);
+    my_assert(http_decode_chunked(bad_chunked, sizeof(bad_chunked) - 1, decoded, sizeof(decoded), &decoded_len) == PARSING_RES_FAILED);
+
+    my_assert(http_parser_stats_get(&stats));
+    my_assert(stats.messages == 1);
+    my_assert(stats.chunked_bodies == 1);
+    my_assert(stats.not_enough_data == 1);
+    my_assert(stats.not_enough_memory == 1);
+    my_assert(stats.failures[HTTP_PARSER_FAILURE_HEADER] == 1);
+    my_assert(stats.failures[HTTP_PARSER_FAILURE_CHUNKED] == 1);
+    my_assert(stats.failures[HTTP_PARSER_FAILURE_START_LINE] == 0);
+    my_assert(stats.bytes_scanned == sizeof(complete) + sizeof(partial) + sizeof(bad_header) + sizeof(too_many) +
+                                     sizeof(chunked) + sizeof(bad_chunked) - 6);
+    my_assert(stats.header_count[0] == 1); // 2 headers
+    my_assert(stats.header_size[0] == 1);  // 51 bytes
+
+    http_parser_stats_t total = {0};
+    http_parser_stats_add(&total, &stats);
+    http_parser_stats_add(&total, &stats);
+    my_assert(total.messages == 2 && total.failures[HTTP_PARSER_FAILURE_HEADER] == 2 && total.header_count[0] == 2);
+
+    http_parser_stats_reset();
+    my_assert(http_parser_stats_get(&stats) && stats.messages == 0);
+#endif
+}
+
+static void test_request_message_info() {
+    http_header_t headers[8];
+    http_request_t request;
+
+    char upgrade[] =
+        "GET /chat HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Connection: keep-alive, Upgrade\r\n"
+        "Upgrade: websocket\r\n"
+        "Expect: 100-Continue\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n";
+    my_assert(http_parse_request(upgrade, sizeof(upgrade) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_SUCCEEDED);
+    my_assert(request.info.keep_alive);
+    my_assert(request.info.connection_keep_alive && request.info.connection_upgrade && !request.info.connection_close);
+    my_assert(request.info.upgrade_requested);
+    my_assert(strings_match((string){request.info.upgrade, request.info.upgrade_len}, STR("websocket")));
+    my_assert(request.info.expect_continue);
+    my_assert(request.info.has_content_length && request.info.content_length == 0);
+    my_assert(!request.info.has_transfer_encoding && !request.info.length_conflict);
+
+    // HTTP/1.0 closes by default, HTTP/1.1 with "close"
+    char http_1_0[] =
+        "GET / HTTP/1.0\r\n"
+        "Upgrade: h2c\r\n"
+        "\r\n";
+    my_assert(http_parse_request(http_1_0, sizeof(http_1_0) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_SUCCEEDED);
+    my_assert(!request.info.keep_alive);
+    my_assert(!request.info.upgrade_requested);
+
+    char http_1_0_keep_alive[] =
+        "GET / HTTP/1.0\r\n"
+        "Connection: Keep-Alive\r\n"
+        "\r\n";
+    my_assert(http_parse_request(http_1_0_keep_alive, sizeof(http_1_0_keep_alive) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_SUCCEEDED);
+    my_assert(request.info.keep_alive);
+
+    char closing[] =
+        "GET / HTTP/1.1\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+    my_assert(http_parse_request(closing, sizeof(closing) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_SUCCEEDED);
+    my_assert(!request.info.keep_alive);
+
+    // Smuggling attempts are flagged, and rejected by framed parsing
+    char conflict[] =
+        "POST / HTTP/1.1\r\n"
+        "Content-Length: 5\r\n"
+        "Transfer-Encoding: gzip\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "0\r\n"
+        "\r\n";
+    my_assert(http_parse_request(conflict, sizeof(conflict) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_SUCCEEDED);
+    my_assert(request.info.chunked && request.info.length_conflict && request.info.duplicate_content_length);
+    my_assert(!request.info.invalid_content_length);
+
+    char different_lengths[] =
+        "POST / HTTP/1.1\r\n"
+        "Content-Length: 5\r\n"
+        "Content-Length: 6\r\n"
+        "\r\n"
+        "hello!";
+    size_t consumed;
+    my_assert(http_parse_request(different_lengths, sizeof(different_lengths) - 1, headers, ARRAY_LENGTH(headers), &request) == PARSING_RES_SUCCEEDED);
+    my_assert(request.info.invalid_content_length);
+    my_assert(http_parse_request_framed(different_lengths, sizeof(different_lengths) - 1, headers, ARRAY_LENGTH(headers),
+                                        &request, &consumed) == PARSING_RES_FAILED);
+}
+
+static void test_response_message_info() {
+    http_header_t headers[8];
+    http_response_t response;
+
+    // Lasts until the connection is closed
+    char until_close[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "data";
+    my_assert(http_parse_response(until_close, sizeof(until_close) - 1, headers, ARRAY_LENGTH(headers), &response) == PARSING_RES_SUCCEEDED);
+    my_assert(!response.info.keep_alive);
+
+    char no_body[] =
+        "HTTP/1.1 304 Not Modified\r\n"
+        "ETag: \"x\"\r\n"
+        "\r\n";
+    my_assert(http_parse_response(no_body, sizeof(no_body) - 1, headers, ARRAY_LENGTH(headers), &response) == PARSING_RES_SUCCEEDED);
+    my_assert(response.info.keep_alive);
+
+    // Parsed in pieces, the info is kept between calls
+    char chunked[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    http_parser_state_t state;
+    http_parser_state_init(&state);
+    size_t cut = strlen("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConn");
+    my_assert(http_parse_response_continue(&state, chunked, cut, headers, ARRAY_LENGTH(headers), &response) == PARSING_RES_NOT_ENOUGH_DATA);
+    my_assert(http_parse_response_continue(&state, chunked, sizeof(chunked) - 1, headers, ARRAY_LENGTH(headers), &response) == PARSING_RES_SUCCEEDED);
+    my_assert(response.info.chunked && response.info.connection_keep_alive && response.info.keep_alive);
+}
+
+static void test_request_lazy() {
+    char text[] =
+        "POST /upload HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Content-Length: 5\n"
+        "X-Bad Name: 1\r\n"
+        "\r\n"
+        "hello";
+
+    http_lazy_request_t request;
+    http_parsing_result_t result = http_parse_request_lazy(text, sizeof(text) - 1, &request);
+    my_assert(result == PARSING_RES_SUCCEEDED);
+    my_assert(strings_match((string){request.method, request.method_len}, STR("POST")));
+    my_assert(strings_match((string){request.target, request.target_len}, STR("/upload")));
+    my_assert(strings_match((string){request.protocol, request.protocol_len}, STR("HTTP/1.1")));
+    my_assert(strings_match((string){request.header_block, request.header_block_len},
+                            STR("Host: example.com\r\nContent-Length: 5\nX-Bad Name: 1\r\n")));
+    my_assert(strings_match((string){request.body, request.body_len}, STR("hello")));
+
+    // Headers are only checked when they are reached
+    http_header_iter_t iter;
+    http_header_iter_init(&iter, request.header_block, request.header_block_len);
+    http_header_t header;
+    my_assert(http_header_iter_next(&iter, &header) == PARSING_RES_SUCCEEDED);
+    my_assert(header.id == HTTP_HEADER_HOST);
+    my_assert(strings_match((string){header.value, header.value_len}, STR("example.com")));
+    my_assert(http_header_iter_next(&iter, &header) == PARSING_RES_SUCCEEDED);
+    my_assert(header.id == HTTP_HEADER_CONTENT_LENGTH);
+    my_assert(strings_match((string){header.value, header.value_len}, STR("5")));
+    my_assert(http_header_iter_next(&iter, &header) == PARSING_RES_FAILED);
+    my_assert(http_header_iter_next(&iter, &header) == PARSING_RES_NOT_ENOUGH_DATA);
+
+    char no_headers[] = "GET / HTTP/1.0\n\n";
+    my_assert(http_parse_request_lazy(no_headers, sizeof(no_headers) - 1, &request) == PARSING_RES_SUCCEEDED);
+    my_assert(request.header_block_len == 0 && request.body_len == 0);
+    http_header_iter_init(&iter, request.header_block, request.header_block_len);
+    my_assert(http_header_iter_next(&iter, &header) == PARSING_RES_NOT_ENOUGH_DATA);
+
+    char incomplete[] = "GET / HTTP/1.1\r\nHost: x\r\n\r";
+    my_assert(http_parse_request_lazy(incomplete, sizeof(incomplete) - 1, &request) == PARSING_RES_NOT_ENOUGH_DATA);
+
+    char bad_line[] = "GET / FTP/1.1\r\n\r\n";
+    my_assert(http_parse_request_lazy(bad_line, sizeof(bad_line) - 1, &request) == PARSING_RES_FAILED);
+}
+
+static void test_request_lazy_block_end_any_position() {
+    // The blank line at every offset within and across vector widths
+    char text[256];
+    for (size_t filler = 0; filler < 100; filler++) {
+        for (int crlf = 0; crlf < 2; crlf++) {
+            const char* ending = crlf ? "\r\n" : "\n";
+
+            size_t len = (size_t) sprintf(text, "GET / HTTP/1.1%sX: ", ending);
+            memset(text + len, 'a', filler);
+            len += filler;
+            len += (size_t) sprintf(text + len, "%s%sbody", ending, ending);
+
+            http_lazy_request_t request;
+            my_assert(http_parse_request_lazy(text, len, &request) == PARSING_RES_SUCCEEDED);
+            my_assert(request.header_block_len == strlen("X: ") + filler + strlen(ending));
+            my_assert(strings_match((string){request.body, request.body_len}, STR("body")));
+
+            // Cut before the blank line is complete
+            my_assert(http_parse_request_lazy(text, len - strlen("body") - 1, &request) == PARSING_RES_NOT_ENOUGH_DATA);
+        }
+    }
+}
+
+static void test_requests_multi() {
+    // More requests than are parsed in one group, finishing at different rounds
+    static const char* const samples[] = {
+        "GET / HTTP/1.1\r\nHost: a\r\n\r\n",
+        "POST /form HTTP/1.1\r\nHost: b\r\nContent-Length: 3\r\nConnection: close\r\n\r\nabc",
+        "GET /incomplete HTTP/1.1\r\nHost: c\r\n",
+        "GET / FTP/1.1\r\n\r\n",
+        "GET / HTTP/1.0\n\n",
+        "GET / HTTP/1.1\r\nBad Name: 1\r\n\r\n",
+        "GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\nD: 4\r\nE: 5\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: d",
+        "",
+    };
+    enum { REQUESTS = 75, HEADERS = 4 };
+
+    const char* texts[REQUESTS];
+    size_t text_lens[REQUESTS];
+    for (size_t i = 0; i < REQUESTS; i++) {
+        texts[i] = samples[i % ARRAY_LENGTH(samples)];
+        text_lens[i] = strlen(texts[i]);
+    }
+
+    http_header_t headers_pool[REQUESTS * HEADERS];
+    http_request_t requests[REQUESTS];
+    http_parsing_result_t results[REQUESTS];
+    size_t succeeded = http_parse_requests_multi(texts, text_lens, REQUESTS, headers_pool, HEADERS, requests, results);
+
+    // Same as parsing every request alone
+    size_t expected_succeeded = 0;
+    for (size_t i = 0; i < REQUESTS; i++) {
+        http_header_t headers[HEADERS];
+        http_request_t request;
+        http_parsing_result_t result = http_parse_request(texts[i], text_lens[i], headers, HEADERS, &request);
+        my_assert(results[i] == result);
+        if (result != PARSING_RES_SUCCEEDED) {
+            continue;
+        }
+        expected_succeeded++;
+
+        my_assert(strings_match((string){requests[i].method, requests[i].method_len},
+                                (string){request.method, request.method_len}));
+        my_assert(strings_match((string){requests[i].target, requests[i].target_len},
+                                (string){request.target, request.target_len}));
+        my_assert(requests[i].headers == headers_pool + i * HEADERS);
+        my_assert(requests[i].headers_len == request.headers_len);
+        for (size_t j = 0; j < request.headers_len; j++) {
+            my_assert(requests[i].headers[j].id == headers[j].id);
+            my_assert(strings_match((string){requests[i].headers[j].value, requests[i].headers[j].value_len},
+                                    (string){headers[j].value, headers[j].value_len}));
+        }
+        my_assert(requests[i].body == request.body && requests[i].body_len == request.body_len);
+        my_assert(requests[i].info.keep_alive == request.info.keep_alive);
+        my_assert(requests[i].info.content_length == request.info.content_length);
+    }
+    my_assert(succeeded == expected_succeeded);
+    my_assert(results[6] == PARSING_RES_NOT_ENOUGH_MEMORY);
+
+    my_assert(http_parse_requests_multi(NULL, NULL, 0, NULL, 0, NULL, NULL) == 0);
+}
+
+static void run_all_tests() {
+    test_response_full();
+    test_response_invalid_protocol();
+    test_response_invalid_status_code();
+    test_response_custom_status_text();
+    test_response_header_with_newline();
+    test_response_header_no_newline();
+    test_response_incomplete_header();
+    test_response_incomplete_header_with_body();
+    test_response_no_headers();
+    test_response_only_status_line();
+    test_response_only_incomplete_protocol();
+    test_response_incomplete_protocol_with_space();
+    test_response_incomplete_protocol_with_body();
+
+    test_request_full();
+    test_request_full_with_incomplete_protocol();
+    test_request_header_with_newline();
+    test_request_header_no_newline();
+    test_request_incomplete_header();
+    test_request_incomplete_header_with_body();
+    test_request_no_headers();
+    test_request_only_status_line();
+    test_request_incomplete_protocol();
+    test_request_incomplete_protocol_with_body();
+    test_request_long_lines();
+    test_header_ids();
+    test_find_header_indexed();
+    test_find_header_not_indexed();
+    test_find_header_small_index();
+
+    test_decode();
+    test_decode_incomplete();
+    test_decode_length_is_too_big();
+    test_decode_length_is_too_small();
+    test_decode_last_line_invalid();
+    test_decode_in_place();
+    test_decode_iov();
+    test_decode_buffer_too_small();
+    test_decode_streaming_any_split();
+    test_decode_streaming_small_buffer();
+    test_decode_streaming_invalid();
+    test_decode_streaming_same_as_one_shot();
+    test_request_framed_chunked_every_prefix();
+
+    test_request_continue_byte_by_byte();
+    test_request_continue_failed();
+    test_response_continue_not_enough_memory();
+
+    test_request_framed_pipelined();
+    test_request_framed_invalid_content_length();
+    test_response_framed_chunked();
+    test_response_framed_until_close();
+
+    test_request_batch();
+    test_request_batch_failed();
+
+    test_request_compact();
+    test_response_compact_continue_value_too_long();
+
+    test_request_arena_grows_in_place();
+    test_request_arena_grows_into_new_block();
+    test_request_arena_full();
+
+    test_request_callbacks();
+    test_response_callbacks_stopped();
+
+    test_serialize_response();
+    test_serialize_request();
+    test_parse_target();
+    test_percent_decode();
+    test_query_iter();
+    test_decode_hex_sizes();
+    test_parse_content_length();
+    test_response_status_code_out_of_range();
+    test_request_invalid_header_characters();
+    test_request_invalid_characters_any_position();
+    test_parser_stats();
+    test_request_message_info();
+    test_response_message_info();
+    test_request_lazy();
+    test_request_lazy_block_end_any_position();
+    test_requests_multi();
+    test_rewrite_request();
+    test_rewrite_response();
+}
+
+int main(int argc, char* argv[]) {
+    // Every tier of the scanning code has to give the same results
+    static const http_parser_impl_t impls[] = {
+        HTTP_PARSER_IMPL_SCALAR,
+        HTTP_PARSER_IMPL_SSE2,
+        HTTP_PARSER_IMPL_SSE42,
+        HTTP_PARSER_IMPL_AVX2,
+        HTTP_PARSER_IMPL_AVX512,
+    };
+
+    for (size_t i = 0; i < ARRAY_LENGTH(impls); i++) {
+        if (!http_parser_set_impl(impls[i])) {
+            printf("Skipping %s, not supported.\n", translate_http_parser_impl(impls[i]));
+            continue;
+        }
+        my_assert(http_parser_get_impl() == impls[i]);
+
+        run_all_tests();
+        printf("Passed with %s.\n", translate_http_parser_impl(impls[i]));
+    }
+
+    my_assert(http_parser_set_impl(HTTP_PARSER_IMPL_AUTO));
+    my_assert(http_parser_get_impl() != HTTP_PARSER_IMPL_AUTO);
+    run_all_tests();
 
     printf("All tests passed.\n");
 }
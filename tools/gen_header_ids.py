@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+#
+# Generates include/http_header_ids.h and src/http_header_table.h:
+# ids of well-known header names and a perfect hash that maps a name to its id.
+#
+# The hash only looks at the length and three bytes of the name (first, middle, next to last),
+# folded to lower case with | 0x20. Multipliers and table size are searched for here
+# so that no two names land in the same slot. A name that hashes to a slot still has
+# to be compared with the one stored there.
+#
+# Usage: python3 tools/gen_header_ids.py (from the root of the repository)
+
+import random
+import sys
+
+# Permanent entries of the IANA HTTP Field Name Registry that show up in practice
+NAMES = [
+    "A-IM",
+    "Accept",
+    "Accept-Charset",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Accept-Patch",
+    "Accept-Post",
+    "Accept-Ranges",
+    "Access-Control-Allow-Credentials",
+    "Access-Control-Allow-Headers",
+    "Access-Control-Allow-Methods",
+    "Access-Control-Allow-Origin",
+    "Access-Control-Expose-Headers",
+    "Access-Control-Max-Age",
+    "Access-Control-Request-Headers",
+    "Access-Control-Request-Method",
+    "Age",
+    "Allow",
+    "Alt-Svc",
+    "Authorization",
+    "Cache-Control",
+    "Clear-Site-Data",
+    "Connection",
+    "Content-Digest",
+    "Content-Disposition",
+    "Content-Encoding",
+    "Content-Language",
+    "Content-Length",
+    "Content-Location",
+    "Content-Range",
+    "Content-Security-Policy",
+    "Content-Security-Policy-Report-Only",
+    "Content-Type",
+    "Cookie",
+    "Cross-Origin-Embedder-Policy",
+    "Cross-Origin-Opener-Policy",
+    "Cross-Origin-Resource-Policy",
+    "Date",
+    "Early-Data",
+    "ETag",
+    "Expect",
+    "Expires",
+    "Forwarded",
+    "From",
+    "Host",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Keep-Alive",
+    "Last-Modified",
+    "Link",
+    "Location",
+    "Max-Forwards",
+    "Origin",
+    "Pragma",
+    "Prefer",
+    "Preference-Applied",
+    "Priority",
+    "Proxy-Authenticate",
+    "Proxy-Authorization",
+    "Range",
+    "Referer",
+    "Referrer-Policy",
+    "Refresh",
+    "Retry-After",
+    "Sec-Fetch-Dest",
+    "Sec-Fetch-Mode",
+    "Sec-Fetch-Site",
+    "Sec-Fetch-User",
+    "Sec-Purpose",
+    "Sec-WebSocket-Accept",
+    "Sec-WebSocket-Extensions",
+    "Sec-WebSocket-Key",
+    "Sec-WebSocket-Protocol",
+    "Sec-WebSocket-Version",
+    "Server",
+    "Server-Timing",
+    "Set-Cookie",
+    "Strict-Transport-Security",
+    "TE",
+    "Timing-Allow-Origin",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "Upgrade-Insecure-Requests",
+    "User-Agent",
+    "Vary",
+    "Via",
+    "WWW-Authenticate",
+    "Want-Content-Digest",
+    "X-Content-Type-Options",
+    "X-Frame-Options",
+]
+
+
+def enum_name(name):
+    return "HTTP_HEADER_" + name.upper().replace("-", "_")
+
+
+def fold(ch):
+    return ord(ch) | 0x20
+
+
+def hash_name(name, mults, mask):
+    a, b, c, d = mults
+    n = len(name)
+    return (n * a + fold(name[0]) * b + fold(name[n // 2]) * c + fold(name[n - 2]) * d) & mask
+
+
+def search():
+    rng = random.Random(1)
+    for bits in range(7, 12):
+        size = 1 << bits
+        if size < len(NAMES):
+            continue
+        for _ in range(200000):
+            mults = tuple(rng.randrange(1, 256) for _ in range(4))
+            slots = set()
+            for name in NAMES:
+                h = hash_name(name, mults, size - 1)
+                if h in slots:
+                    break
+                slots.add(h)
+            else:
+                return size, mults
+    sys.exit("no perfect hash found")
+
+
+def main():
+    assert len(NAMES) == len(set(n.lower() for n in NAMES))
+    assert len(NAMES) < 256
+
+    size, mults = search()
+    table = [0] * size
+    for i, name in enumerate(NAMES):
+        table[hash_name(name, mults, size - 1)] = i + 1
+
+    with open("include/http_header_ids.h", "w", newline="\n") as f:
+        f.write("/* Generated by tools/gen_header_ids.py, don't edit. */\n\n")
+        f.write("#ifndef LIB_HTTP_HEADER_IDS_H\n#define LIB_HTTP_HEADER_IDS_H\n\n")
+        f.write("/* Ids of well-known header names (permanent entries of the IANA HTTP Field Name Registry). */\n")
+        f.write("typedef enum {\n")
+        f.write("    HTTP_HEADER_UNKNOWN,\n")
+        for name in NAMES:
+            f.write("    %s,\n" % enum_name(name))
+        f.write("\n    HTTP_HEADER_COUNT,\n")
+        f.write("} http_header_id_t;\n\n")
+        f.write("#endif /* LIB_HTTP_HEADER_IDS_H */\n")
+
+    with open("src/http_header_table.h", "w", newline="\n") as f:
+        f.write("/* Generated by tools/gen_header_ids.py, don't edit. */\n\n")
+        f.write("#ifndef LIB_HTTP_HEADER_TABLE_H\n#define LIB_HTTP_HEADER_TABLE_H\n\n")
+        f.write("#include \"http_parser.h\"\n\n")
+        f.write("#define HEADER_HASH(len, first, middle, next_to_last) \\\n")
+        f.write("    (((len) * %du + (first) * %du + (middle) * %du + (next_to_last) * %du) & %du)\n\n" % (mults + (size - 1,)))
+        f.write("#define HEADER_NAME_MIN_LEN %d\n" % min(len(n) for n in NAMES))
+        f.write("#define HEADER_NAME_MAX_LEN %d\n\n" % max(len(n) for n in NAMES))
+        f.write("static const struct {\n    const char *name;\n    size_t name_len;\n} header_names[HTTP_HEADER_COUNT] = {\n")
+        f.write("    {\"\", 0},\n")
+        for name in NAMES:
+            f.write("    {\"%s\", %d},\n" % (name, len(name)))
+        f.write("};\n\n")
+        f.write("/* Slot of HEADER_HASH -> id */\n")
+        f.write("static const uint8_t header_hash_table[%d] = {\n" % size)
+        for i in range(0, size, 16):
+            f.write("    " + " ".join("%3d," % v for v in table[i:i + 16]) + "\n")
+        f.write("};\n\n")
+        f.write("#endif /* LIB_HTTP_HEADER_TABLE_H */\n")
+
+    print("%d names, table size %d, multipliers %s" % (len(NAMES), size, mults))
+
+
+if __name__ == "__main__":
+    main()